@@ -1,30 +1,50 @@
 #include "app.hpp"
 
-app::mix::mix(std::string const& n, sound_defs const& d)
-    : name(n)
-    , pars(d)
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+static std::string read_text(std::string const& filename)
 {
+    std::ifstream t(filename);
+    return std::string(std::istreambuf_iterator<char>(t), std::istreambuf_iterator<char>());
 }
-void app::mix::write_file()
+
+// next to the parse cache, not in the working directory the app was started from
+static std::filesystem::path session_path()
 {
-    std::ofstream(pars.filename, std::ofstream::trunc) << pars.buffer;
-    saved = true;
+    return parse_cache::user_folder() / "session.dcs";
 }
 
+app::mix::mix(std::string const& n, sound_pool& pool, parse_worker& parses)
+    : name(n)
+    , pars(pool)
+    , worker(parses)
+{
+}
 void app::mix::read_file()
 {
-    std::ifstream t(pars.filename);
-    pars.buffer.assign((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-    saved = true;
+    pars.buffer = read_text(pars.filename);
+    saved       = true;
 }
 
-app::app()
-    : sg()
+app::app(bool offline)
+    : sg(offline)
     , ch(sg)
+    , cache(sg.pool, parse_cache::user_folder())
+    , parses(sg.pool, std::clamp(std::thread::hardware_concurrency(), 1u, 4u))
+    , snapshots(session_path())
+    , offline(offline)
 {
     set_file("temp.dcp");
 }
 
+app::~app()
+{
+    snapshot(true);
+}
+
 void app::new_file(std::filesystem::path const& folder, std::string const& filename)
 {
     auto const filepath = folder / filename;
@@ -41,57 +61,311 @@ void app::new_file(std::filesystem::path const& folder, std::string const& filen
 void app::set_file(std::filesystem::path const& p)
 {
     mixes.clear();
+    files.clear();
     current_folder.clear();
-    ch.asts.clear();
+    ch.clear();
+    files_version++;
+    watcher.watch(p.parent_path());
     add_file(p);
 }
 
 void app::add_file(std::filesystem::path const& p)
 {
-    std::string const filename = p.generic_string();
-    std::string const mixname  = p.filename().stem().string();
-    for (auto& mx : mixes) {
-        if (mx.second.pars.filename == filename) {
-            mx.second.read_file();
-            return;
-        }
+    if (auto* m = find_file(p.generic_string())) {
+        m->read_file();
+        return;
+    }
+    if (auto* m = emplace_mix(p)) {
+        load({ m });
     }
-    auto mx = mixes.emplace(std::piecewise_construct, std::forward_as_tuple(mixname),
-                            std::forward_as_tuple(mixname, sg.defs));
-    mx.first->second.pars.filename = filename;
-    mx.first->second.read_file();
-    parse(mx.first->second);
 }
 
 void app::set_folder(std::filesystem::path const& p)
 {
     current_folder = p.generic_string();
     mixes.clear();
-    ch.asts.clear();
+    files.clear();
+    ch.clear();
+    files_version++;
+    watcher.watch(p);
     namespace fs = std::filesystem;
     using dir_it = fs::directory_iterator;
+    std::vector<mix*> added;
     for (auto it = dir_it(p); it != dir_it(); it++) {
         if (it->is_regular_file() && it->path().extension() == ".dcp") {
-            add_file(it->path());
+            if (auto* m = emplace_mix(it->path())) {
+                added.push_back(m);
+            }
         }
     }
+    load(added);
+}
+
+app::mix* app::emplace_mix(std::filesystem::path const& p)
+{
+    std::string const filename = p.generic_string();
+    std::string const mixname  = p.filename().stem().string();
+    auto const        mx       = mixes.emplace(std::piecewise_construct,
+                                        std::forward_as_tuple(mixname),
+                                        std::forward_as_tuple(mixname, sg.pool, parses));
+    if (!mx.second) {
+        std::cerr << "Mix " << mixname << " already loaded, " << filename << " ignored"
+                  << std::endl;
+        return nullptr;
+    }
+    mx.first->second.pars.filename = filename;
+    files[filename]                = mixname;
+    files_version++;
+    return &mx.first->second;
+}
+
+// runs fn(0) to fn(n - 1) on up to one thread per core, the calling thread included
+template<typename Fn>
+static void parallel_for(size_t n, Fn const& fn)
+{
+    std::atomic<size_t> next { 0 };
+    auto const          work = [&] {
+        for (size_t i = next++; i < n; i = next++) {
+            fn(i);
+        }
+    };
+    size_t const nb_threads
+        = std::min<size_t>(n, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nb_threads; t++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void app::load(std::vector<mix*> ms)
+{
+    // largest files first, so the longest parse is not the last one started
+    std::vector<std::pair<uintmax_t, mix*>> by_size;
+    for (auto* m : ms) {
+        std::error_code ec;
+        auto const      size = std::filesystem::file_size(m->pars.filename, ec);
+        by_size.emplace_back(ec ? 0 : size, m);
+    }
+    std::sort(by_size.begin(), by_size.end(),
+              [](auto const& a, auto const& b) { return a.first > b.first; });
+
+    std::vector<mix*> todo;
+    for (auto const& m : by_size) {
+        todo.push_back(m.second);
+    }
+    // mixes only touch their own parser, the cache and the sound pool are shared
+    // each wave parses the mixes still failing, with the trees of the previous waves
+    for (bool first = true; !todo.empty(); first = false) {
+        auto const        all = trees();
+        std::vector<char> ok(todo.size());
+        parallel_for(todo.size(), [&](size_t i) {
+            if (first) {
+                todo[i]->read_file();
+            }
+            ok[i] = parse_tree(*todo[i], all);
+        });
+        std::vector<mix*> failed;
+        for (size_t i = 0; i < todo.size(); i++) {
+            if (ok[i]) {
+                on_parsed(*todo[i]);
+            }
+            else {
+                failed.push_back(todo[i]);
+            }
+        }
+        if (failed.size() == todo.size()) {
+            break;
+        }
+        todo.swap(failed);
+    }
+    // mixes importing each other never get a tree, the parser only sees cycles through trees
+    for (auto* m : todo) {
+        auto const cycle = import_cycle(m->name, [this](std::string const& n) {
+            std::vector<std::string> names;
+            auto const               it = mixes.find(n);
+            if (it != mixes.end() && ch.mixes.find(n) == ch.mixes.end()) {
+                for (auto const& i : it->second.pars.imports) {
+                    names.push_back(i.name);
+                }
+            }
+            return names;
+        });
+        if (!cycle.empty()) {
+            m->pars.error = "import cycle " + cycle;
+        }
+        on_failed(*m);
+    }
+    for (auto* m : ms) {
+        update_dependents(m->name);
+    }
+}
+
+bool app::restore(std::filesystem::path const& opened)
+{
+    session s;
+    // a single file is only in the snapshot when it had a tree
+    if (!s.load(session_path(), sg.pool) || (s.folder.empty() && s.mixes.size() != 1)) {
+        return false;
+    }
+    if (!opened.empty()
+        && opened.generic_string() != (s.folder.empty() ? s.mixes[0].filename : s.folder)) {
+        return false;
+    }
+    mixes.clear();
+    files.clear();
+    ch.clear();
+    files_version++;
+    current_folder = s.folder;
+    watcher.watch(s.folder.empty() ? std::filesystem::path(s.mixes[0].filename).parent_path()
+                                   : std::filesystem::path(s.folder));
+
+    // the snapshot plays before any file is read
+    std::vector<mix*> restored;
+    for (auto& sm : s.mixes) {
+        auto* m = emplace_mix(sm.filename);
+        if (!m) {
+            continue;
+        }
+        m->tree_content = sm.content;
+        m->pars.tree    = sm.tree;
+        ch.set_mix(m->name, sm.tree);
+        auto& nodes = ch.mixes.at(m->name).nodes;
+        for (auto const& q : sm.sequences) {
+            if (q.id < nodes.size()) {
+                nodes[q.id].start_m = q.start_m;
+                nodes[q.id].loops   = q.loops;
+            }
+        }
+        restored.push_back(m);
+    }
+    ch.tempo             = s.tempo;
+    ch.beats_per_measure = s.beats_per_measure;
+    ch.measure           = s.measure;
+    ch.beat              = s.beat;
+    ch.sub_beat          = s.sub_beat;
+    is_running           = s.running;
+
+    // then the files are checked against it
+    std::vector<char> same(restored.size());
+    parallel_for(restored.size(), [&](size_t i) {
+        auto& m = *restored[i];
+        if (std::filesystem::exists(m.pars.filename)) {
+            m.read_file();
+            same[i] = parse_cache::hash(m.pars.buffer) == m.tree_content;
+        }
+    });
+    auto const        all = trees();
+    std::vector<mix*> changed;
+    std::vector<mix*> removed;
+    for (size_t i = 0; i < restored.size(); i++) {
+        auto& m = *restored[i];
+        if (!same[i]) {
+            (std::filesystem::exists(m.pars.filename) ? changed : removed).push_back(&m);
+            continue;
+        }
+        m.pars.highlight();
+        for (auto const& name : imported_mixes(*m.pars.tree)) {
+            m.pars.imports.push_back({ name, import_hash(name, all) });
+        }
+    }
+    for (auto* m : removed) {
+        remove(*m);
+    }
+    if (!current_folder.empty()) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        for (auto it = fs::directory_iterator(current_folder, ec);
+             !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            if (it->path().extension() == ".dcp" && !find_file(it->path().generic_string())) {
+                if (auto* m = emplace_mix(it->path())) {
+                    changed.push_back(m);
+                }
+            }
+        }
+    }
+    load(changed);
+    return true;
 }
 
 void app::update()
 {
+    poll_files();
+    poll_parses();
+    poll_saves();
     if (is_running) {
         ch.update();
     }
+    else {
+        ch.link();
+    }
+    snapshot();
+}
+
+void app::snapshot(bool now)
+{
+    auto const t = std::chrono::steady_clock::now();
+    if (offline || (!now && t < next_snapshot)) {
+        return;
+    }
+    next_snapshot = t + std::chrono::seconds(1);
+    std::array<int, 6> const key { files_version, state_version, is_running,
+                                   ch.tempo,      ch.measure,    ch.beat };
+    if (!now && key == snapshot_key) {
+        return;
+    }
+    snapshot_key = key;
+
+    session s;
+    s.folder            = current_folder;
+    s.running           = is_running;
+    s.tempo             = ch.tempo;
+    s.beats_per_measure = ch.beats_per_measure;
+    s.measure           = ch.measure;
+    s.beat              = ch.beat;
+    s.sub_beat          = ch.sub_beat;
+    s.synths            = sg.defs.synths();
+    s.samples           = sg.defs.samples();
+    for (auto const& mx : mixes) {
+        auto const played = ch.mixes.find(mx.first);
+        if (played == ch.mixes.end() || !played->second.tree) {
+            continue;
+        }
+        session::mix sm;
+        sm.filename = mx.second.pars.filename;
+        sm.content  = mx.second.tree_content;
+        sm.tree     = played->second.tree;
+
+        auto const& nodes = played->second.nodes;
+        for (node_id id = 0; id < nodes.size(); id++) {
+            if (nodes[id].start_m != 0 || nodes[id].loops != 0) {
+                sm.sequences.push_back({ id, nodes[id].start_m, nodes[id].loops });
+            }
+        }
+        s.mixes.push_back(std::move(sm));
+    }
+    snapshots.submit(std::move(s));
 }
 
 void app::zero()
 {
-    ch.beat     = 1;
-    ch.measure  = 1;
-    ch.sub_beat = 0;
+    ch.rewind();
     parse_all();
 }
 
+score_result app::export_score(std::filesystem::path const& path, score_options const& opt)
+{
+    return write_score(path, trees(), sg.pool, sg.load_packets(), opt);
+}
+
+midi_result app::export_midi(std::filesystem::path const& path, midi_options const& opt)
+{
+    return write_midi(path, trees(), sg.pool, opt);
+}
+
 void app::parse(std::string const& mn)
 {
     auto mix = mixes.find(mn);
@@ -103,10 +377,196 @@ void app::parse(std::string const& mn)
 
 void app::parse(mix& m)
 {
+    if (parse_tree(m, trees())) {
+        on_parsed(m);
+        update_dependents(m.name);
+    }
+    else {
+        on_failed(m);
+    }
+}
+
+bool app::parse_tree(mix& m, mix_trees const& all)
+{
+    m.parsed_version = ++m.version;
+    m.pars.mixes     = all;
+    if (cache.load(m.pars)) {
+        return true;
+    }
     if (m.pars.parse()) {
-        ch.asts[m.name] = m.pars.tree;
-        if (auto_save)
-            m.write_file();
+        cache.store(m.pars);
+        return true;
+    }
+    return false;
+}
+
+void app::parse_async(mix& m)
+{
+    m.worker.submit(m.pars.buffer, ++m.version, m.pars.filename, trees());
+}
+
+mix_trees app::trees() const
+{
+    mix_trees all;
+    for (auto const& mx : mixes) {
+        auto const played = ch.mixes.find(mx.first);
+        all.emplace(mx.first, played == ch.mixes.end() ? nullptr : played->second.tree);
+    }
+    return all;
+}
+
+void app::update_dependents(std::string const& name)
+{
+    auto const all  = trees();
+    auto const hash = import_hash(name, all);
+    for (auto& mx : mixes) {
+        auto const& imports = mx.second.pars.imports;
+        // a failed parse keeps the hashes it saw, it is not retried until the import changes
+        if (std::any_of(imports.begin(), imports.end(), [&](mix_import const& i) {
+                return i.name == name && i.hash != hash;
+            })) {
+            parse_async(mx.second);
+        }
+    }
+}
+
+void app::poll_parses()
+{
+    parse_worker::result res;
+    for (auto& mx : mixes) {
+        auto& m = mx.second;
+        if (!m.worker.poll(res) || res.version <= m.parsed_version) {
+            continue;
+        }
+        m.parsed_version = res.version;
+        state_version++;
+        m.pars.char_types.swap(res.char_types);
+        m.pars.error.swap(res.error);
+        m.pars.line = res.line;
+        m.pars.col  = res.col;
+        m.pars.imports.swap(res.imports);
+        if (res.ok) {
+            m.pars.tree = std::move(res.tree);
+            on_parsed(m);
+            // the buffer was edited again while it was parsed
+            if (res.version != m.version) {
+                m.tree_content = 0;
+            }
+            update_dependents(m.name);
+        }
+        else {
+            on_failed(m);
+        }
+    }
+}
+
+void app::on_failed(mix const& m)
+{
+    std::cerr << "Parse failed: " << m.pars.filename << ":" << m.pars.line << ":" << m.pars.col
+              << " " << m.pars.error << std::endl;
+}
+
+void app::on_parsed(mix& m)
+{
+    state_version++;
+    m.tree_content = parse_cache::hash(m.pars.buffer);
+    ch.set_mix(m.name, m.pars.tree);
+    // a mix just read from its file has nothing to save
+    if (auto_save && !m.saved)
+        save(m);
+}
+
+void app::save(mix& m)
+{
+    m.written.push_back(parse_cache::hash(m.pars.buffer));
+    if (m.written.size() > 8) {
+        m.written.pop_front();
+    }
+    saver.submit(m.pars.filename, m.pars.buffer, m.version);
+}
+
+void app::poll_files()
+{
+    for (auto const& filename : watcher.poll()) {
+        mix* m = find_file(filename);
+        if (!std::filesystem::exists(filename)) {
+            if (m) {
+                remove(*m);
+            }
+        }
+        else if (m) {
+            reload(*m);
+        }
+        else if (!current_folder.empty()) {
+            add_file(filename);
+        }
+    }
+}
+
+void app::reload(mix& m)
+{
+    std::string content = read_text(m.pars.filename);
+    auto const  h       = parse_cache::hash(content);
+    if (content == m.pars.buffer
+        || std::find(m.written.begin(), m.written.end(), h) != m.written.end()) {
+        return;
+    }
+    // the external edit wins over the unsaved ones
+    saver.cancel(m.pars.filename);
+    m.pars.buffer.swap(content);
+    m.saved = true;
+    parse(m);
+}
+
+void app::remove(mix& m)
+{
+    std::string const name = m.name;
+    saver.cancel(m.pars.filename);
+    files.erase(m.pars.filename);
+    ch.remove_mix(name);
+    mixes.erase(name);
+    files_version++;
+    update_dependents(name);
+}
+
+app::mix* app::find_file(std::string const& filename)
+{
+    auto const f = files.find(filename);
+    return f == files.end() ? nullptr : &mixes.at(f->second);
+}
+
+void app::poll_saves()
+{
+    save_worker::result res;
+    while (saver.poll(res)) {
+        state_version++;
+        if (!res.ok) {
+            std::cerr << "Save failed: " << res.error << std::endl;
+        }
+        mix* m = find_file(res.filename);
+        if (!m) {
+            continue;
+        }
+        if (!res.ok) {
+            m->save_error = res.error;
+        }
+        else {
+            m->save_error.clear();
+            // edits made while the write was pending keep the mix unsaved
+            m->saved = m->saved || res.version == m->version;
+        }
+    }
+    // reported once, not on every snapshot while it keeps failing
+    std::string error;
+    while (snapshots.poll(error)) {
+        if (error == snapshot_error) {
+            continue;
+        }
+        state_version++;
+        if (!error.empty()) {
+            std::cerr << "Session snapshot failed: " << error << std::endl;
+        }
+        snapshot_error = std::move(error);
     }
 }
 
@@ -125,12 +585,14 @@ void app::read_all()
         mix.second.read_file();
         parse(mix.second);
     }
-    auto_save = true;
+    auto_save = prev_as;
 }
 
 void app::write_all()
 {
     for (auto& mix : mixes) {
-        mix.second.write_file();
+        save(mix.second);
     }
+    saver.flush();
+    poll_saves();
 }
\ No newline at end of file
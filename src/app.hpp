@@ -1,23 +1,45 @@
 #pragma once
 #include "chef/chef.hpp"
+#include "io/file_watcher.hpp"
+#include "io/midi.hpp"
+#include "io/save_worker.hpp"
+#include "io/score.hpp"
+#include "io/session.hpp"
+#include "parser/parse_cache.hpp"
+#include "parser/parse_worker.hpp"
 #include "parser/parser.hpp"
 #include "soundgen/soundgen.hpp"
 
+#include <array>
+#include <chrono>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 
 class app {
     public:
-    soundgen sg;
-    chef     ch;
+    soundgen       sg;
+    chef           ch;
+    parse_cache    cache;
+    parse_worker   parses; // shared by the mixes, each parses on its own slot
+    save_worker    saver;
+    file_watcher   watcher;
+    session_writer snapshots;
 
     struct mix {
-        std::string const name;
-        parser            pars;
-        bool              saved = true;
-        mix(std::string const& n, sound_defs const& d);
-        void write_file();
+        std::string const    name;
+        parser               pars;
+        parse_worker::slot   worker;
+        bool                 saved          = true;
+        int                  version        = 0;
+        int                  parsed_version = 0;
+        std::string          save_error; // last failed write, cleared by a successful one
+        std::deque<uint64_t> written;    // hashes of the last contents sent to the save worker
+        // parse_cache::hash of the source of the tree given to the chef, 0 when unknown
+        uint64_t             tree_content = 0;
+        mix(std::string const& n, sound_pool& pool, parse_worker& parses);
         void read_file();
 
         private:
@@ -27,13 +49,25 @@ class app {
 
     std::map<std::string, mix> mixes;
 
+    // changes when mixes are added or removed
+    int files_version = 0;
+
+    // changes when a parse, save or reload result arrives, the ui redraws then
+    int state_version = 0;
+
     bool is_running = false;
 
     bool auto_save = true;
 
     std::string current_folder;
 
-    app();
+    std::string snapshot_error; // last failed session write, cleared by a successful one
+
+    // offline, nothing is sent to a server and no session snapshot is written, for exports
+    explicit app(bool offline = false);
+
+    // the last snapshot is written for the next restore
+    ~app();
 
     void new_file(std::filesystem::path const& folder, std::string const& filename);
 
@@ -43,21 +77,87 @@ class app {
 
     void set_folder(std::filesystem::path const& p);
 
+    // reopens the mixes of the last session snapshot and resumes its transport
+    // the snapshot trees are played at once, files changed since are parsed again
+    // with a path, only a snapshot of that folder or file is restored
+    bool restore(std::filesystem::path const& opened = {});
+
     void update();
 
     void zero();
 
+    // plays the mixes from the first measure on a virtual clock into a scsynth NRT score
+    score_result export_score(std::filesystem::path const& path, score_options const& opt);
+
+    // same for a standard MIDI file, one track per mix
+    midi_result export_midi(std::filesystem::path const& path, midi_options const& opt);
+
     void parse(std::string const& mn);
 
+    // uses the parse cache when the file content was already parsed
     void parse(mix& m);
 
+    // parses on the mix worker slot, the result is applied by a later update()
+    void parse_async(mix& m);
+
     void parse_all();
 
     void read_all();
 
+    // writes the mixes now, pending autosaves included
     void write_all();
 
     private:
+    // mix names by filename
+    std::unordered_map<std::string, std::string> files;
+
+    void poll_parses();
+
+    // results of the file saves and of the session snapshots
+    void poll_saves();
+
+    void save(mix& m);
+
+    // reloads the mixes changed on disk, except by our own saves
+    void poll_files();
+
+    // null when a mix with the same name is already loaded
+    mix* emplace_mix(std::filesystem::path const& p);
+
+    // reads and parses the mixes in parallel, then hands their trees to the chef
+    // mixes importing others are parsed again once their imports have a tree
+    void load(std::vector<mix*> ms);
+
+    // parse without publishing the tree, safe to run for several mixes at once
+    bool parse_tree(mix& m, mix_trees const& all);
+
+    // every mix with the tree played by the chef, for imports
+    mix_trees trees() const;
+
+    // parses again the mixes that imported the mix when it exported something else
+    // on their worker slots, their own dependents follow when poll_parses applies them
+    void update_dependents(std::string const& name);
+
+    void reload(mix& m);
+
+    void remove(mix& m);
+
+    mix* find_file(std::string const& filename);
+
+    void on_parsed(mix& m);
+
+    // parsers run on worker threads, their errors are reported from here
+    void on_failed(mix const& m);
+
+    // submits a session snapshot once per second, when something changed
+    void snapshot(bool now = false);
+
+    std::chrono::steady_clock::time_point next_snapshot;
+
+    std::array<int, 6> snapshot_key {};
+
+    bool const offline;
+
     app(app const&) = delete;
     app& operator=(app const&) = delete;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "chef/ast.hpp"
 
+#include <algorithm>
 #include <sstream>
 
 std::string tabs(int level)
@@ -8,13 +9,22 @@ std::string tabs(int level)
 }
 
 struct printer {
-    int         level = 0;
+    ast const&        a;
+    sound_defs const& defs;
+    int               level = 0;
     std::string operator()(comment const& i) { return " ~ " + i.text + "\n"; }
     std::string operator()(rest const&) { return "rest\n"; }
     std::string operator()(affect const& i)
     {
         std::stringstream s;
-        s << i.name << " " << i.val << "\n";
+        s << i.name << " ";
+        if (i.expr.empty()) {
+            s << i.val;
+        }
+        else {
+            s << i.expr;
+        }
+        s << "\n";
         return s.str();
     }
     std::string operator()(on_beat const& i)
@@ -31,20 +41,28 @@ struct printer {
         return std::visit(
             [&](auto i) {
                 std::stringstream s;
-                s << "'" << i.name << "'";
+                s << "'" << defs.name(i.ref()) << "'";
                 bool       first           = true;
                 size_t     nb_params       = i.params.size();
                 bool const too_many_params = nb_params > 4;
 
                 std::string const sep
                     = too_many_params ? ("\n" + tabs(level + 1)) : std::string(" ");
-                for (auto& param : i.params) {
-                    float const param_val = param.second;
+                for (auto const param : i.params) {
                     if (first) {
                         s << " (";
                         first = false;
                     }
-                    s << sep + i.param_name(param.first) + ":" << param_val;
+                    s << sep + i.param_name(param.first) + ":";
+                    auto const expr = std::find_if(
+                        ps.exprs.begin(), ps.exprs.end(),
+                        [&](param_expr const& e) { return e.param == int(param.first); });
+                    if (expr != ps.exprs.end()) {
+                        s << expr->text;
+                    }
+                    else {
+                        s << param.second;
+                    }
                 }
                 if (!first) {
                     s << (too_many_params ? ("\n" + tabs(level)) : " ") << ")";
@@ -52,7 +70,7 @@ struct printer {
                 s << "\n";
                 return s.str();
             },
-            ps.sound);
+            ps.sound->sound);
     }
     std::string operator()(between_measure const& i)
     {
@@ -75,80 +93,183 @@ struct printer {
         s += "\n";
         return s;
     }
+    std::string operator()(repeat const& i)
+    {
+        std::string s = "repeat " + std::to_string(i.times);
+        visit_vec(i.statements, s);
+        return s;
+    }
+    std::string operator()(every const& i)
+    {
+        std::string s = "every " + std::to_string(i.period);
+        visit_vec(i.statements, s);
+        return s;
+    }
+    std::string operator()(pattern_def const& i)
+    {
+        std::string s = "def " + i.name + ":";
+        visit_vec(i.statements, s);
+        s += "\n";
+        return s;
+    }
+    std::string operator()(pattern_use const& i)
+    {
+        std::string s = "use " + i.name;
+        if (i.transpose != 0 || i.offset != 0) {
+            s += " (";
+            if (i.transpose != 0) {
+                s += " transpose:" + std::to_string(i.transpose);
+            }
+            if (i.offset != 0) {
+                s += " offset:" + std::to_string(i.offset);
+            }
+            s += " )";
+        }
+        return s + "\n";
+    }
+    std::string operator()(import_mix const& i) { return "import '" + i.name + "'\n"; }
 
-    void visit_vec(std::vector<statement> const& stts, std::string& s)
+    void visit_vec(node_range r, std::string& s)
     {
+        auto const stts = a.children(r);
         if (stts.size() == 1) {
-            s += " " + std::visit(*this, stts[0]);
+            s += " " + a.visit(*this, stts[0]);
             return;
         }
         s += "\n";
         auto    tab = tabs(level + 1);
-        printer p2 { level + 1 };
-        for (auto& st : stts) {
-            s += tab + std::visit(p2, st);
+        printer p2 { a, defs, level + 1 };
+        for (auto st : stts) {
+            s += tab + a.visit(p2, st);
         }
     }
 };
 
-void print(ast const& a, std::string& s)
+void print(ast const& a, sound_defs const& defs, std::string& s)
 {
     s.clear();
-    printer p;
-    for (auto& st : a) {
-        s += std::visit(p, st);
+    printer p { a, defs };
+    for (auto st : a.roots()) {
+        s += a.visit(p, st);
+    }
+}
+
+std::vector<std::string> imported_mixes(ast const& a)
+{
+    std::vector<std::string> names;
+    for (auto const id : a.roots()) {
+        if (a.is<import_mix>(id)) {
+            names.push_back(a.get<import_mix>(id).name);
+        }
     }
+    return names;
 }
 
-ast test_1()
+std::vector<std::pair<node_id, node_id>> match_sequences(ast const& from, ast const& to)
+{
+    // node ids follow the source order
+    auto sequences = [](ast const& a) {
+        std::vector<std::pair<int, node_id>> res;
+        for (node_id id = 0; id < a.size(); id++) {
+            if (a.is<sequence>(id)) {
+                res.emplace_back(a.get<sequence>(id).nb_measure, id);
+            }
+        }
+        return res;
+    };
+    auto const a = sequences(from);
+    auto const b = sequences(to);
+
+    std::vector<std::pair<node_id, node_id>> pairs;
+    auto same = [&](size_t i, size_t j) { return a[i].first == b[j].first; };
+
+    // an edit is local, the common prefix and suffix leave a small middle to diff
+    size_t pre = 0;
+    while (pre < a.size() && pre < b.size() && same(pre, pre)) {
+        pairs.emplace_back(a[pre].second, b[pre].second);
+        pre++;
+    }
+    size_t suf = 0;
+    while (suf < a.size() - pre && suf < b.size() - pre
+           && same(a.size() - 1 - suf, b.size() - 1 - suf)) {
+        suf++;
+    }
+
+    // longest common subsequence of the middles
+    size_t const n = a.size() - pre - suf;
+    size_t const m = b.size() - pre - suf;
+    if (n > 0 && m > 0 && n * m <= 1 << 20) {
+        std::vector<uint32_t> lcs((n + 1) * (m + 1), 0);
+        auto at = [&](size_t i, size_t j) -> uint32_t& { return lcs[i * (m + 1) + j]; };
+        for (size_t i = n; i-- > 0;) {
+            for (size_t j = m; j-- > 0;) {
+                at(i, j) = same(pre + i, pre + j) ? at(i + 1, j + 1) + 1
+                                                  : std::max(at(i + 1, j), at(i, j + 1));
+            }
+        }
+        for (size_t i = 0, j = 0; i < n && j < m;) {
+            if (same(pre + i, pre + j)) {
+                pairs.emplace_back(a[pre + i].second, b[pre + j].second);
+                i++;
+                j++;
+            }
+            else if (at(i + 1, j) >= at(i, j + 1)) {
+                i++;
+            }
+            else {
+                j++;
+            }
+        }
+    }
+    for (size_t k = suf; k > 0; k--) {
+        pairs.emplace_back(a[a.size() - k].second, b[b.size() - k].second);
+    }
+    return pairs;
+}
+
+ast test_1(sound_pool& pool)
 {
     ast   a;
-    synth s1 { 0, "sonic-pi-beep" };
+    synth s1 { 0 };
     s1.params[synth::note] = 52;
-    synth s2 { 0, "sonic-pi-beep" };
+    synth s2 { 0 };
     s2.params[synth::note] = 60;
 
+    auto on = [&a, &pool](int beat, std::vector<synth> const& synths) {
+        std::vector<node_id> plays;
+        for (auto& s : synths) {
+            plays.push_back(a.add(play_sound { pool.intern(s) }));
+        }
+        return a.add(on_beat { beat, 1, 1, a.add_links(plays) });
+    };
+    auto measures = [&a](int m1, int m2, std::vector<node_id> const& stts) {
+        return a.add(between_measure { m1, m2, a.add_links(stts) });
+    };
+
+    std::vector<node_id> roots;
+    roots.push_back(measures(1, 1, { a.add(affect { "tempo", 120 }) }));
     {
-        between_measure m1;
-        m1.m1 = m1.m2 = 1;
-        m1.statements.emplace_back(affect { "tempo", 120 });
-        a.push_back(m1);
-    }
-    {
-        between_measure ms;
-        ms.m1 = 1;
-        ms.m2 = 6;
-        ms.statements.emplace_back(on_beat { 1, 1, 1, { play_sound { s1 } } });
+        std::vector<node_id> stts;
+        stts.push_back(on(1, { s1 }));
         s1.params[synth::note] = 54;
-        ms.statements.emplace_back(on_beat { 2, 1, 1, { play_sound { s1 } } });
+        stts.push_back(on(2, { s1 }));
         s1.params[synth::note] = 56;
-        ms.statements.emplace_back(on_beat { 3, 1, 1, { play_sound { s1 } } });
-        ms.statements.emplace_back(on_beat { 4, 1, 1, { play_sound { s2 } } });
-        a.push_back(ms);
-    }
-    {
-        between_measure m1;
-        m1.m1 = m1.m2 = 7;
-        m1.statements.emplace_back(affect { "tempo", 118 });
-        a.push_back(m1);
+        stts.push_back(on(3, { s1 }));
+        stts.push_back(on(4, { s2 }));
+        roots.push_back(measures(1, 6, stts));
     }
+    roots.push_back(measures(7, 7, { a.add(affect { "tempo", 118 }) }));
     {
-        between_measure ms;
-        ms.m1                  = 7;
-        ms.m2                  = 8;
+        std::vector<node_id> stts;
         s1.params[synth::note] = 52;
-        ms.statements.emplace_back(on_beat { 1, 1, 1, { play_sound { s1 } } });
-        ms.statements.emplace_back(on_beat { 2, 1, 1, { play_sound { s1 }, play_sound { s2 } } });
+        stts.push_back(on(1, { s1 }));
+        stts.push_back(on(2, { s1, s2 }));
         s1.params[synth::note] = 56;
-        ms.statements.emplace_back(on_beat { 3, 1, 1, { play_sound { s1 }, play_sound { s2 } } });
-        ms.statements.emplace_back(on_beat { 4, 1, 1, { play_sound { s2 } } });
-        a.push_back(ms);
-    }
-    {
-        between_measure m1;
-        m1.m1 = m1.m2 = 9;
-        m1.statements.emplace_back(affect { "measure", 1 });
-        a.push_back(m1);
+        stts.push_back(on(3, { s1, s2 }));
+        stts.push_back(on(4, { s2 }));
+        roots.push_back(measures(7, 8, stts));
     }
+    roots.push_back(measures(9, 9, { a.add(affect { "measure", 1 }) }));
+    a.set_roots(roots);
     return a;
 }
\ No newline at end of file
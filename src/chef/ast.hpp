@@ -1,6 +1,10 @@
 #pragma once
-#include "soundgen/soundgen.hpp"
+#include "soundgen/sound_pool.hpp"
 
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
@@ -9,73 +13,295 @@ struct source {
     int end;
 };
 
-struct comment;
-struct rest;
-struct affect;
-struct on_beat;
-struct between_measure;
-struct play_sound;
-struct sequence;
+using node_id = uint32_t;
 
-using statement = std::variant<comment,         //
-                               rest,            //
-                               affect,          //
-                               on_beat,         //
-                               play_sound,      //
-                               between_measure, //
-                               sequence         //
-                               >;
+// children of a node, as a range in ast links
+struct node_range {
+    uint32_t begin = 0;
+    uint32_t end   = 0;
+};
 
 struct rest {
-    source _src;
 };
 
 struct comment {
     std::string text;
-
-    source _src;
 };
 
 struct affect {
     std::string name;
     float       val;
-
-    source _src;
+    std::string expr = {}; // source of val when it was computed, printed instead of it
 };
 
 struct on_beat {
-    int                    beat;
-    int                    sub_beat = 1;
-    int                    nb_sub   = 1;
-    std::vector<statement> statements;
-
-    source _src;
+    int        beat;
+    int        sub_beat   = 1;
+    int        nb_sub     = 1;
+    node_range statements = {};
 };
 
 struct between_measure {
-    int                    m1, m2;
-    std::vector<statement> statements;
+    int        m1, m2;
+    node_range statements = {};
+};
 
-    source _src;
+// source of a param value computed from an expression
+struct param_expr {
+    int         param;
+    std::string text;
 };
 
+// identical sounds share their entry, see sound_pool
 struct play_sound {
-    std::variant<synth, sample> sound;
-
-    source _src;
+    sound_ptr               sound;
+    std::vector<param_expr> exprs = {};
 };
 
 struct sequence {
-    int                    nb_measure;
-    std::vector<statement> statements;
+    int        nb_measure;
+    node_range statements = {};
+};
+
+// body played `times` times over the enclosing sequence or measure
+struct repeat {
+    int        times;
+    node_range statements = {};
+};
+
+// body played on one pass out of `period` of the enclosing loop
+struct every {
+    int        period;
+    node_range statements = {};
+};
+
+// named pattern, only played where it is used
+struct pattern_def {
+    std::string name;
+    node_range  statements = {};
+};
+
+// plays a pattern of the mix or of its imports, else of any mix of the folder
+struct pattern_use {
+    std::string name;
+    int         transpose = 0; // semitones added to synth notes
+    int         offset    = 0; // in beats
+};
+
+// values and patterns of another mix of the folder, by mix name
+struct import_mix {
+    std::string name;
+};
+
+// order of the payload tables, node_kind values are indices in this list
+using node_types = std::tuple<comment,         //
+                              rest,            //
+                              affect,          //
+                              on_beat,         //
+                              play_sound,      //
+                              between_measure, //
+                              sequence,        //
+                              repeat,          //
+                              every,           //
+                              pattern_def,     //
+                              pattern_use,     //
+                              import_mix       //
+                              >;
+
+enum class node_kind : uint8_t {
+    comment,
+    rest,
+    affect,
+    on_beat,
+    play_sound,
+    between_measure,
+    sequence,
+    repeat,
+    every,
+    pattern_def,
+    pattern_use,
+    import_mix,
+};
+
+template<typename T, typename Tuple>
+struct node_type_index;
+
+template<typename T, typename... Ts>
+struct node_type_index<T, std::tuple<Ts...>> {
+    static constexpr size_t value()
+    {
+        size_t     i     = 0;
+        bool const found = ((std::is_same_v<T, Ts> ? true : (++i, false)) || ...);
+        return found ? i : sizeof...(Ts);
+    }
+};
+
+template<typename T>
+constexpr node_kind kind_of = node_kind(node_type_index<T, node_types>::value());
 
-    source _src;
+struct node {
+    node_kind kind;
+    uint32_t  payload; // index in the table of its kind
+    source    _src;
+};
+
+// Flat tree: nodes in one array, children as ranges of node ids, payloads in one table per kind
+class ast {
+    template<typename... Ts>
+    using tables_of = std::tuple<std::vector<Ts>...>;
+
+    template<typename Tuple>
+    struct tables_for;
+    template<typename... Ts>
+    struct tables_for<std::tuple<Ts...>> {
+        using type = tables_of<Ts...>;
+    };
+
+    std::vector<node>    nodes;
+    std::vector<node_id> links;
+    node_range           root_range;
+
+    typename tables_for<node_types>::type tables;
+
+    template<typename T>
+    std::vector<T>& table()
+    {
+        return std::get<std::vector<T>>(tables);
+    }
+    template<typename T>
+    std::vector<T> const& table() const
+    {
+        return std::get<std::vector<T>>(tables);
+    }
+
+    public:
+    struct span {
+        node_id const* b;
+        node_id const* e;
+
+        node_id const* begin() const { return b; }
+        node_id const* end() const { return e; }
+        size_t         size() const { return size_t(e - b); }
+        bool           empty() const { return b == e; }
+        node_id        operator[](size_t i) const { return b[i]; }
+    };
+
+    template<typename T>
+    node_id add(T payload, source src = {})
+    {
+        auto& t = table<T>();
+        t.push_back(std::move(payload));
+        nodes.push_back({ kind_of<T>, uint32_t(t.size() - 1), src });
+        return node_id(nodes.size() - 1);
+    }
+
+    node_range add_links(std::vector<node_id> const& ids)
+    {
+        node_range const r { uint32_t(links.size()), uint32_t(links.size() + ids.size()) };
+        links.insert(links.end(), ids.begin(), ids.end());
+        return r;
+    }
+
+    void set_roots(std::vector<node_id> const& ids) { root_range = add_links(ids); }
+
+    void set_source(node_id id, source src) { nodes[id]._src = src; }
+
+    span roots() const { return children(root_range); }
+
+    span children(node_range r) const { return { links.data() + r.begin, links.data() + r.end }; }
 
-    int s_start_m = 0;
+    node_kind kind(node_id id) const { return nodes[id].kind; }
+
+    source const& src(node_id id) const { return nodes[id]._src; }
+
+    template<typename T>
+    bool is(node_id id) const
+    {
+        return nodes[id].kind == kind_of<T>;
+    }
+
+    template<typename T>
+    T& get(node_id id)
+    {
+        assert(is<T>(id));
+        return table<T>()[nodes[id].payload];
+    }
+
+    template<typename T>
+    T const& get(node_id id) const
+    {
+        assert(is<T>(id));
+        return table<T>()[nodes[id].payload];
+    }
+
+    // calls vis with the payload of the node
+    template<typename Visitor>
+    decltype(auto) visit(Visitor&& vis, node_id id)
+    {
+        return visit_impl(*this, std::forward<Visitor>(vis), id);
+    }
+
+    template<typename Visitor>
+    decltype(auto) visit(Visitor&& vis, node_id id) const
+    {
+        return visit_impl(*this, std::forward<Visitor>(vis), id);
+    }
+
+    // number of nodes
+    size_t size() const { return nodes.size(); }
+
+    bool empty() const { return root_range.begin == root_range.end; }
+
+    void clear()
+    {
+        nodes.clear();
+        links.clear();
+        root_range = {};
+        std::apply([](auto&... t) { (t.clear(), ...); }, tables);
+    }
+
+    private:
+    // reads and writes the tables, see parser/ast_io
+    friend struct ast_io;
+
+    template<typename Ast, typename Visitor>
+    static decltype(auto) visit_impl(Ast& a, Visitor&& vis, node_id id)
+    {
+        auto const& n = a.nodes[id];
+        switch (n.kind) {
+        case node_kind::comment: return vis(a.template table<comment>()[n.payload]);
+        case node_kind::rest: return vis(a.template table<rest>()[n.payload]);
+        case node_kind::affect: return vis(a.template table<affect>()[n.payload]);
+        case node_kind::on_beat: return vis(a.template table<on_beat>()[n.payload]);
+        case node_kind::play_sound: return vis(a.template table<play_sound>()[n.payload]);
+        case node_kind::between_measure:
+            return vis(a.template table<between_measure>()[n.payload]);
+        case node_kind::sequence: return vis(a.template table<sequence>()[n.payload]);
+        case node_kind::repeat: return vis(a.template table<repeat>()[n.payload]);
+        case node_kind::every: return vis(a.template table<every>()[n.payload]);
+        case node_kind::pattern_def: return vis(a.template table<pattern_def>()[n.payload]);
+        case node_kind::pattern_use: return vis(a.template table<pattern_use>()[n.payload]);
+        case node_kind::import_mix: break;
+        }
+        return vis(a.template table<import_mix>()[n.payload]);
+    }
 };
 
-using ast = std::vector<statement>;
+static_assert(kind_of<import_mix> == node_kind::import_mix);
+static_assert(std::tuple_size_v<node_types> == size_t(node_kind::import_mix) + 1);
+
+// parsed trees are published as immutable snapshots shared by the editor and the chef
+using ast_ptr = std::shared_ptr<ast const>;
+
+// sound names are looked up in the defs the tree was parsed with
+void print(ast const&, sound_defs const&, std::string&);
+
+// names of the mixes imported by the tree, in order
+std::vector<std::string> imported_mixes(ast const&);
 
-void print(ast const&, std::string&);
+// sequences of a reparsed tree paired with those of the previous one, as (from, to) ids
+// sequences are diffed in source order by their length in measures, so nodes added or removed
+// around them, or edits inside them, keep the pairs
+std::vector<std::pair<node_id, node_id>> match_sequences(ast const& from, ast const& to);
 
-ast test_1();
\ No newline at end of file
+ast test_1(sound_pool& pool);
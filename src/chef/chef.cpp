@@ -1,95 +1,348 @@
 #include "chef/chef.hpp"
 
+#include "io/event_log.hpp"
+
+#include <algorithm>
 #include <iostream>
 
-chef::chef(soundgen& sg)
-    : sg(sg)
+void mix_state::set_tree(ast_ptr t)
 {
-    last_call = std::chrono::system_clock::now();
+    auto const prev_tree  = std::move(tree);
+    auto const prev_nodes = std::move(nodes);
+    tree                  = std::move(t);
+    nodes.assign(tree ? tree->size() : 0, {});
+    if (!tree || !prev_tree) {
+        return;
+    }
+    for (auto const& [from, to] : match_sequences(*prev_tree, *tree)) {
+        if (from < prev_nodes.size()) {
+            nodes[to] = prev_nodes[from];
+        }
+    }
 }
 
-void chef::update()
+void mix_state::reset()
 {
-    auto          now = std::chrono::system_clock::now();
-    int64_t const elapsed_us
-        = std::chrono::duration_cast<std::chrono::microseconds>(now - last_call).count();
-    int64_t const dt_us = int64_t((60.0 / tempo) * 1000000) / sub_beats_per_beat;
-    if (elapsed_us < dt_us) {
-        return;
+    for (auto& n : nodes) {
+        n.start_m = 0;
+        n.loops   = 0;
     }
-    sub_beat++;
-    if (sub_beat > sub_beats_per_beat) {
-        sub_beat = 1;
-        beat++;
-        if (beat > beats_per_measure) {
-            beat = 1;
-            measure++;
+}
+
+// walks the tree of one mix for the current sub beat
+// sequences and repeats give their children a local beat position, the chef transport is
+// left untouched. Repeated bodies and patterns are played from their single copy in the tree.
+struct player {
+    struct cursor {
+        int beat;
+        int beats_per_measure; // length of the enclosing loop, in beats
+        int pass;              // iteration of the enclosing loop, from 0
+        int transpose = 0;     // semitones added by the enclosing patterns
+    };
+
+    // patterns using themselves stop there
+    static constexpr int max_depth = 8;
+
+    chef&      ch;
+    mix_state& mx;
+    ast const& tree;
+    cursor     pos;
+    int        depth = 0;
+    node_id    id    = 0;
+
+    void visit_all(node_range r)
+    {
+        for (auto st : tree.children(r)) {
+            visit(st);
         }
-        std::cout << measure << ":" << beat << "/" << beats_per_measure
-                  << " elapsed: " << elapsed_us / 1000 << "ms" << std::endl;
     }
 
-    for (auto& a : asts) {
-        for (auto& st : a.second) {
-            std::visit(*this, st);
+    void visit(node_id st)
+    {
+        id = st;
+        tree.visit(*this, st);
+    }
+
+    void operator()(comment const&) {}
+    void operator()(rest const&) {}
+
+    void operator()(affect const& i)
+    {
+        if (i.name == "tempo") {
+            ch.tempo = int(i.val);
+        }
+        else if (i.name == "measure") {
+            ch.measure = int(i.val);
+        }
+    }
+
+    void operator()(on_beat const& i)
+    {
+        int const sub_on = (i.sub_beat - 1) * ch.sub_beats_per_beat / i.nb_sub;
+        int const cur_on = ch.sub_beat - 1;
+        if (i.beat == pos.beat && sub_on == cur_on) {
+            visit_all(i.statements);
         }
     }
+
+    void operator()(between_measure const& i)
+    {
+        if (i.m1 <= ch.measure && (i.m2 < 0 || i.m2 >= ch.measure)) {
+            visit_all(i.statements);
+        }
+    }
+
+    void operator()(sequence const& i)
+    {
+        auto& st = mx.nodes[id];
+        if (st.start_m == 0 || ch.measure < st.start_m
+            || ch.measure - st.start_m >= i.nb_measure) {
+            if (st.start_m != 0) {
+                st.loops++;
+            }
+            st.start_m = ch.measure;
+        }
+        cursor const inner { pos.beat + (pos.beats_per_measure * (ch.measure - st.start_m)),
+                             i.nb_measure * pos.beats_per_measure, st.loops, pos.transpose };
+        player { ch, mx, tree, inner, depth }.visit_all(i.statements);
+    }
+
+    void operator()(repeat const& i)
+    {
+        int const len = pos.beats_per_measure / i.times;
+        if (len == 0) {
+            return;
+        }
+        int const rep = (pos.beat - 1) / len;
+        if (rep >= i.times) {
+            return;
+        }
+        cursor const inner { (pos.beat - 1) % len + 1, len, rep, pos.transpose };
+        player { ch, mx, tree, inner, depth }.visit_all(i.statements);
+    }
+
+    void operator()(every const& i)
+    {
+        if (pos.pass % i.period == 0) {
+            visit_all(i.statements);
+        }
+    }
+
+    void operator()(pattern_def const&) {}
+    void operator()(import_mix const&) {}
+
+    void operator()(pattern_use const& i)
+    {
+        auto const& ref = mx.uses[id];
+        int const   bpm = pos.beats_per_measure;
+        if (!ref.owner || depth >= max_depth || bpm <= 0) {
+            return;
+        }
+        // the offset delays the pattern, wrapping around the enclosing loop
+        int const beat = ((pos.beat - 1 - i.offset) % bpm + bpm) % bpm + 1;
+        auto&        owner = *ref.owner;
+        cursor const inner { beat, bpm, pos.pass, pos.transpose + i.transpose };
+        player { ch, owner, *owner.tree, inner, depth + 1 }.visit_all(
+            owner.tree->get<pattern_def>(ref.id).statements);
+    }
+
+    void operator()(play_sound const& i)
+    {
+        auto const& snd = pos.transpose == 0 ? *i.sound : ch.transpose(i.sound, pos.transpose);
+        if (ch.trace) {
+            std::cout << pos.beat << " " << ch.sub_beat << "/" << ch.sub_beats_per_beat << " ";
+            std::visit(
+                [this](auto const& s) { std::cout << ch.pool.defs().name(s.ref()) << std::endl; },
+                snd.sound);
+        }
+        if (ch.output) {
+            ch.output(mx.name, snd);
+        }
+        else if (ch.sg) {
+            ch.sg->play(snd);
+        }
+        if (ch.log) {
+            ch.log->append(mx.name, tree.src(id), snd.osc);
+        }
+    }
+};
+
+chef::chef(soundgen& sg)
+    : chef(sg.pool)
+{
+    this->sg = &sg;
+}
+
+chef::chef(sound_pool& pool)
+    : pool(pool)
+{
     last_call = std::chrono::system_clock::now();
 }
 
-void chef::operator()(affect& i)
+void chef::set_mix(std::string const& name, ast_ptr tree)
 {
-    if (i.name == "tempo") {
-        tempo = int(i.val);
+    auto& m = mixes[name];
+    m.name  = name;
+    m.set_tree(std::move(tree));
+    linked = false;
+}
+
+void chef::remove_mix(std::string const& name)
+{
+    mixes.erase(name);
+    linked = false;
+}
+
+void chef::clear()
+{
+    mixes.clear();
+    linked = false;
+}
+
+void chef::link()
+{
+    if (linked) {
+        return;
     }
-    else if (i.name == "measure") {
-        measure = int(i.val);
+    std::vector<std::pair<std::string const*, mix_state*>> sorted;
+    for (auto& m : mixes) {
+        sorted.emplace_back(&m.first, &m.second);
     }
+    std::sort(sorted.begin(), sorted.end(),
+              [](auto const& a, auto const& b) { return *a.first < *b.first; });
+
+    using defs = std::unordered_map<std::string, pattern_ref>;
+    std::unordered_map<std::string, defs> by_mix;
+    patterns.clear();
+    for (auto const& m : sorted) {
+        auto const& tree = m.second->tree;
+        if (!tree) {
+            continue;
+        }
+        auto& own = by_mix[*m.first];
+        for (auto const id : tree->roots()) {
+            if (tree->is<pattern_def>(id)) {
+                auto const& name = tree->get<pattern_def>(id).name;
+                own.emplace(name, pattern_ref { m.second, id });
+                patterns.emplace(name, pattern_ref { m.second, id });
+            }
+        }
+    }
+    // a mix looks in itself, then in its imports in order, then in the whole folder
+    auto find = [&](std::string const& mix, std::string const& name, pattern_ref& ref) {
+        auto const d = by_mix.find(mix);
+        if (d == by_mix.end()) {
+            return false;
+        }
+        auto const it = d->second.find(name);
+        if (it == d->second.end()) {
+            return false;
+        }
+        ref = it->second;
+        return true;
+    };
+    for (auto const& m : sorted) {
+        auto& mx       = *m.second;
+        auto  previous = std::move(mx.unresolved);
+        mx.unresolved.clear();
+        mx.uses.assign(mx.tree ? mx.tree->size() : 0, {});
+        if (mx.uses.empty()) {
+            continue;
+        }
+        auto const imports = imported_mixes(*mx.tree);
+        for (node_id id = 0; id < mx.uses.size(); id++) {
+            if (!mx.tree->is<pattern_use>(id)) {
+                continue;
+            }
+            auto const& name = mx.tree->get<pattern_use>(id).name;
+            auto&       ref  = mx.uses[id];
+            if (find(*m.first, name, ref)
+                || std::any_of(imports.begin(), imports.end(),
+                               [&](auto const& i) { return find(i, name, ref); })) {
+                continue;
+            }
+            if (auto const it = patterns.find(name); it != patterns.end()) {
+                ref = it->second;
+                continue;
+            }
+            if (std::find(mx.unresolved.begin(), mx.unresolved.end(), name)
+                != mx.unresolved.end()) {
+                continue;
+            }
+            mx.unresolved.push_back(name);
+            // reported once, not on every reparse while it stays undefined
+            if (std::find(previous.begin(), previous.end(), name) == previous.end()) {
+                std::cerr << "Mix " << mx.name << ": pattern '" << name << "' is not defined"
+                          << std::endl;
+            }
+        }
+    }
+    transposed.clear();
+    linked = true;
 }
 
-void chef::operator()(on_beat& i)
+sound_entry const& chef::transpose(sound_ptr const& s, int semitones)
 {
-    int const sub_on = (i.sub_beat - 1) * sub_beats_per_beat / i.nb_sub;
-    int const cur_on = sub_beat - 1;
-    if (i.beat == beat && sub_on == cur_on) {
-        for (auto& st : i.statements) {
-            std::visit(*this, st);
+    auto& t = transposed[{ s.get(), semitones }];
+    if (!t.second) {
+        auto snd = s->sound;
+        if (auto* syn = std::get_if<synth>(&snd); syn && syn->params.contains(synth::note)) {
+            syn->params[synth::note] += float(semitones);
         }
+        t = { s, pool.intern(std::move(snd)) };
     }
+    return *t.second;
 }
 
-void chef::operator()(between_measure& i)
+void chef::rewind()
 {
-    if (i.m1 <= measure && (i.m2 < 0 || i.m2 >= measure)) {
-        for (auto& st : i.statements) {
-            std::visit(*this, st);
-        }
+    beat     = 1;
+    measure  = 1;
+    sub_beat = 0;
+    for (auto& m : mixes) {
+        m.second.reset();
     }
 }
 
-void chef::operator()(sequence& i)
+void chef::update()
 {
-    auto const prev_beat = beat;
-    auto const prev_bpm  = beats_per_measure;
-    if (i.s_start_m == 0 || measure - i.s_start_m >= i.nb_measure) {
-        i.s_start_m = measure;
-    }
-    beat              = beat + (prev_bpm * (measure - i.s_start_m));
-    beats_per_measure = i.nb_measure * beats_per_measure;
-    for (auto& st : i.statements) {
-        std::visit(*this, st);
-    }
-    beat              = prev_beat;
-    beats_per_measure = prev_bpm;
+    auto          now = std::chrono::system_clock::now();
+    int64_t const elapsed_us
+        = std::chrono::duration_cast<std::chrono::microseconds>(now - last_call).count();
+    int64_t const dt_us = int64_t((60.0 / tempo) * 1000000) / sub_beats_per_beat;
+    if (elapsed_us < dt_us) {
+        return;
+    }
+    if (trace && sub_beat == sub_beats_per_beat) {
+        auto const next_measure = beat == beats_per_measure ? measure + 1 : measure;
+        auto const next_beat    = beat == beats_per_measure ? 1 : beat + 1;
+        std::cout << next_measure << ":" << next_beat << "/" << beats_per_measure
+                  << " elapsed: " << elapsed_us / 1000 << "ms" << std::endl;
+    }
+    step();
+    last_call = std::chrono::system_clock::now();
 }
 
-void chef::operator()(play_sound& i)
+void chef::step()
 {
-    std::cout << beat << " " << sub_beat << "/" << sub_beats_per_beat << " ";
-    std::visit(
-        [this](auto& snd) {
-            std::cout << snd.name << std::endl;
-            sg.play(snd);
-        },
-        i.sound);
+    sub_beat++;
+    if (sub_beat > sub_beats_per_beat) {
+        sub_beat = 1;
+        beat++;
+        if (beat > beats_per_measure) {
+            beat = 1;
+            measure++;
+        }
+    }
+
+    link();
+    for (auto& m : mixes) {
+        if (!m.second.tree) {
+            continue;
+        }
+        player p { *this, m.second, *m.second.tree, { beat, beats_per_measure, measure - 1 } };
+        for (auto st : m.second.tree->roots()) {
+            p.visit(st);
+        }
+    }
 }
\ No newline at end of file
@@ -3,16 +3,53 @@
 #include "soundgen/soundgen.hpp"
 
 #include <chrono>
+#include <functional>
+#include <map>
 #include <unordered_map>
 
+// playback state of a node, kept out of the shared tree
+struct node_state {
+    int start_m = 0; // measure a sequence was (re)started at, 0 if not started
+    int loops   = 0; // times a sequence wrapped around
+};
+
+struct mix_state;
+
+class event_log_writer;
+
+// a pattern_def node and the mix defining it
+struct pattern_ref {
+    mix_state* owner = nullptr;
+    node_id    id    = 0;
+};
+
+// a mix as played by the chef: its current tree and the state of its nodes, by node id
+struct mix_state {
+    std::string              name;
+    ast_ptr                  tree;
+    std::vector<node_state>  nodes;
+    std::vector<pattern_ref> uses;       // resolved pattern_use nodes, see chef::link
+    std::vector<std::string> unresolved; // names of used patterns no mix defines
+
+    // sequences matched in the new tree keep their state, so a reparse keeps their phase
+    // see match_sequences
+    void set_tree(ast_ptr t);
+
+    void reset();
+};
+
 class chef {
     std::chrono::system_clock::time_point last_call;
 
-    soundgen& sg;
+    sound_pool& pool;
+    soundgen*   sg = nullptr;
 
     public:
     chef(soundgen& sg);
 
+    // without a server, played sounds only go to output
+    explicit chef(sound_pool& pool);
+
     int tempo = 90;
 
     int beats_per_measure = 4;
@@ -25,19 +62,50 @@ class chef {
 
     int measure = 1;
 
-    std::unordered_map<std::string, ast> asts;
+    std::unordered_map<std::string, mix_state> mixes;
+
+    // records every played sound when set
+    event_log_writer* log = nullptr;
+
+    // when set, played sounds are given to it with their mix instead of the soundgen
+    std::function<void(std::string const& mix, sound_entry const&)> output;
+
+    // prints played sounds and measures
+    bool trace = true;
 
+    void set_mix(std::string const& name, ast_ptr tree);
+
+    void remove_mix(std::string const& name);
+
+    void clear();
+
+    // steps when a sub beat elapsed since the last step, at the current tempo
     void update();
 
-    void operator()(comment&) {}
-    void operator()(rest&) {}
-    void operator()(affect& i);
-    void operator()(on_beat& i);
-    void operator()(between_measure& i);
-    void operator()(sequence& i);
-    void operator()(play_sound& i);
+    // advances one sub beat and plays it, without looking at the clock
+    void step();
+
+    // back to the first measure, sequences restart
+    void rewind();
+
+    // resolves pattern uses of all mixes when trees changed since the last call
+    // step links first, a stopped chef is linked by calling this
+    void link();
 
     private:
+    friend struct player;
+
+    // patterns of all mixes, the first mix by name wins on duplicates
+    // a mix finds its own patterns and those of its imports before these
+    std::unordered_map<std::string, pattern_ref> patterns;
+
+    // transposed copies of sounds, keyed by source entry, which is kept alive by the value
+    std::map<std::pair<sound_entry const*, int>, std::pair<sound_ptr, sound_ptr>> transposed;
+
+    bool linked = true;
+
+    sound_entry const& transpose(sound_ptr const& s, int semitones);
+
     chef(chef const&) = delete;
     chef& operator=(chef const&) = delete;
 };
\ No newline at end of file
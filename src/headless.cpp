@@ -0,0 +1,306 @@
+#include "app.hpp"
+#include "io/event_log.hpp"
+#include "io/midi.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// Player without display: loads a mix file or a folder of mixes and plays it.
+// Transport is driven by lines on stdin or by signals:
+//   play, stop, zero, reload, tempo <bpm>, quit
+//   SIGUSR1 toggles play, SIGUSR2 goes back to the first measure, SIGINT and SIGTERM quit
+// With --record, played sounds are appended to an event log, which --replay sends again.
+// With --export or --midi, the mixes are written as a score for scsynth -N or as a MIDI file,
+// without a server.
+
+namespace {
+
+volatile std::sig_atomic_t signal_quit   = 0;
+volatile std::sig_atomic_t signal_toggle = 0;
+volatile std::sig_atomic_t signal_zero   = 0;
+
+extern "C" void on_signal(int sig)
+{
+    switch (sig) {
+#ifdef SIGUSR1
+    case SIGUSR1: signal_toggle = 1; break;
+    case SIGUSR2: signal_zero = 1; break;
+#endif
+    default: signal_quit = 1; break;
+    }
+}
+
+// lines read from stdin on their own thread, so the player loop never blocks on input
+// a closed stdin, as under a service manager, leaves the player running
+struct command_reader {
+    std::mutex              mtx;
+    std::deque<std::string> lines;
+
+    void start()
+    {
+        std::thread([this] {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                std::lock_guard<std::mutex> lk(mtx);
+                lines.push_back(std::move(line));
+            }
+        }).detach();
+    }
+
+    bool next(std::string& line)
+    {
+        std::lock_guard<std::mutex> lk(mtx);
+        if (lines.empty()) {
+            return false;
+        }
+        line = std::move(lines.front());
+        lines.pop_front();
+        return true;
+    }
+};
+
+// false on quit
+bool run_command(app& ap, std::string const& line)
+{
+    auto const sp  = line.find(' ');
+    auto const cmd = line.substr(0, sp);
+    if (cmd == "play") {
+        ap.is_running = true;
+    }
+    else if (cmd == "stop") {
+        ap.is_running = false;
+    }
+    else if (cmd == "zero") {
+        ap.zero();
+    }
+    else if (cmd == "reload") {
+        ap.read_all();
+    }
+    else if (cmd == "tempo" && sp != std::string::npos) {
+        ap.ch.tempo = std::max(1, std::atoi(line.c_str() + sp + 1));
+    }
+    else if (cmd == "quit") {
+        return false;
+    }
+    else if (!cmd.empty()) {
+        std::cerr << "unknown command '" << cmd << "'" << std::endl;
+    }
+    return true;
+}
+
+// sends the events of a log again, at their recorded times or as fast as possible
+int replay(std::filesystem::path const& path, bool asap)
+{
+    using clock = std::chrono::steady_clock;
+
+    event_log log;
+    if (!log.load(path)) {
+        std::cerr << "cannot read event log " << path << std::endl;
+        return 1;
+    }
+    soundgen sg;
+    if (sg.defs.synths() != log.synths || sg.defs.samples() != log.samples) {
+        std::cerr << "the log was recorded with other sounds, buffer ids may not match"
+                  << std::endl;
+    }
+
+    int64_t const first = log.events.empty() ? 0 : log.events.front().time_us;
+    auto const    start = clock::now();
+    size_t        sent  = 0;
+    for (auto const& e : log.events) {
+        if (signal_quit) {
+            break;
+        }
+        if (!asap) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(e.time_us - first));
+            std::cout << (e.time_us - first) / 1000 << "ms " << log.mixes[e.mix] << " "
+                      << e.src.begin << "-" << e.src.end << std::endl;
+        }
+        sg.send(e.osc);
+        sent++;
+    }
+    auto const us
+        = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    std::cout << "sent " << sent << " events in " << us / 1000 << "ms";
+    if (us > 0) {
+        std::cout << ", " << int64_t(double(sent) * 1000000 / double(us)) << " events/s";
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+// command line arguments after the program name
+struct options {
+    std::vector<std::string> args;
+
+    bool has(char const* opt) const
+    {
+        return std::find(args.begin(), args.end(), opt) != args.end();
+    }
+
+    // value following an option, empty when missing
+    std::string value(char const* opt) const
+    {
+        auto const it = std::find(args.begin(), args.end(), opt);
+        return it != args.end() && it + 1 != args.end() ? *(it + 1) : std::string();
+    }
+};
+
+// plays the mixes on a virtual clock into a score or a MIDI file, as fast as the scheduler runs
+int export_song(std::filesystem::path const& path, options const& opts)
+{
+    using clock = std::chrono::steady_clock;
+
+    double seconds = 60;
+    int    tempo   = 90;
+    if (opts.has("--seconds")) {
+        seconds = std::max(0.0, std::atof(opts.value("--seconds").c_str()));
+    }
+    if (opts.has("--tempo")) {
+        tempo = std::max(1, std::atoi(opts.value("--tempo").c_str()));
+    }
+    app ap(true);
+    if (std::filesystem::is_directory(path)) {
+        ap.set_folder(path);
+    }
+    else {
+        ap.set_file(path);
+    }
+    auto const start   = clock::now();
+    auto       elapsed = [&] {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+    };
+
+    if (opts.has("--export")) {
+        auto const out = opts.value("--export");
+        auto const res = ap.export_score(out, { seconds, 2, tempo });
+        if (!res.ok) {
+            std::cerr << res.error << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << res.sounds << " sounds, " << res.seconds << "s of score in "
+                  << elapsed() << "ms\nrender with: scsynth -N " << out
+                  << " _ out.wav 48000 WAV int16 -o 2" << std::endl;
+        return 0;
+    }
+
+    midi_options opt { seconds, tempo, default_drum_map(ap.sg.defs) };
+    std::string  error;
+    if (opts.has("--drums")
+        && !read_drum_map(opts.value("--drums"), ap.sg.defs, opt.drums, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    auto const res = ap.export_midi(opts.value("--midi"), opt);
+    if (!res.ok) {
+        std::cerr << res.error << std::endl;
+        return 1;
+    }
+    std::cout << "wrote " << res.notes << " notes in " << elapsed() << "ms";
+    if (res.skipped > 0) {
+        std::cout << ", skipped " << res.skipped << " samples without a drum note";
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+try {
+    options const opts { { argv + 1, argv + argc } };
+    auto const&   args = opts.args;
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, on_signal);
+    std::signal(SIGUSR2, on_signal);
+#endif
+
+    if (opts.has("--replay") && !opts.value("--replay").empty()) {
+        return replay(opts.value("--replay"), opts.has("--asap"));
+    }
+    bool const missing = std::any_of(args.begin(), args.end(), [&](auto const& a) {
+        return (a == "--record" || a == "--export" || a == "--midi" || a == "--drums")
+               && opts.value(a.c_str()).empty();
+    });
+    if (args.empty() || args[0].rfind("--", 0) == 0 || missing) {
+        std::cerr << "usage: " << argv[0] << " <mix.dcp | folder> [--paused] [--record <log>]\n"
+                  << "       " << argv[0] << " --replay <log> [--asap]\n"
+                  << "       " << argv[0]
+                  << " <mix.dcp | folder> --export <score.osc> [--seconds <s>] [--tempo <bpm>]\n"
+                  << "       " << argv[0]
+                  << " <mix.dcp | folder> --midi <song.mid> [--drums <map>] [--seconds <s>]"
+                     " [--tempo <bpm>]"
+                  << std::endl;
+        return 1;
+    }
+    std::filesystem::path const path(args[0]);
+    bool const                  paused = opts.has("--paused");
+
+    if (opts.has("--export") || opts.has("--midi")) {
+        return export_song(path, opts);
+    }
+
+    // declared before the app, which plays until it is destroyed
+    std::unique_ptr<event_log_writer> recorder;
+
+    app ap;
+    if (opts.has("--record")) {
+        recorder  = std::make_unique<event_log_writer>(opts.value("--record"), ap.sg.defs);
+        ap.ch.log = recorder.get();
+        if (!recorder->ok()) {
+            std::cerr << "cannot write event log " << opts.value("--record") << std::endl;
+            return 1;
+        }
+    }
+    // a snapshot of the same folder or file resumes where the last run was
+    if (!ap.restore(path)) {
+        if (std::filesystem::is_directory(path)) {
+            ap.set_folder(path);
+        }
+        else {
+            ap.set_file(path);
+        }
+        ap.is_running = true;
+    }
+    ap.is_running = ap.is_running && !paused;
+
+    // left alive at exit, the reader thread may still be blocked on stdin
+    auto* const commands = new command_reader;
+    commands->start();
+
+    std::string line;
+    while (!signal_quit) {
+        if (signal_toggle) {
+            signal_toggle = 0;
+            ap.is_running = !ap.is_running;
+        }
+        if (signal_zero) {
+            signal_zero = 0;
+            ap.zero();
+        }
+        bool quit = false;
+        while (!quit && commands->next(line)) {
+            quit = !run_command(ap, line);
+        }
+        if (quit) {
+            break;
+        }
+        ap.update();
+        // well under a sub beat, 1/48 of a beat is 5ms at 250 bpm
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return 0;
+}
+catch (std::exception const& e) {
+    std::cerr << "FATAL ERROR: " << e.what() << std::endl;
+    return 1;
+}
\ No newline at end of file
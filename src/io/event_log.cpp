@@ -0,0 +1,230 @@
+#include "io/event_log.hpp"
+
+#include "parser/ast_io.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace fs  = std::filesystem;
+namespace bip = boost::interprocess;
+
+namespace {
+
+char const     file_magic[4] = { 'D', 'C', 'P', 'E' };
+uint32_t const file_format   = 1;
+
+struct header {
+    char     magic[4];
+    uint32_t format;
+};
+
+// a mix name is recorded before its first event, events refer to it by index
+enum class record : uint8_t { mix = 1, sound = 2 };
+
+// buffered events are written at least this often
+auto const write_interval = std::chrono::milliseconds(100);
+
+// and as soon as this many bytes are buffered
+size_t const write_size = 64 * 1024;
+
+void put_names(byte_writer& w, std::vector<std::string> const& names)
+{
+    w.pod(uint32_t(names.size()));
+    for (auto const& n : names) {
+        w.str(n);
+    }
+}
+
+std::vector<std::string> get_names(byte_reader& r)
+{
+    std::vector<std::string> names(r.count(4));
+    for (auto& n : names) {
+        n = r.str();
+    }
+    return names;
+}
+
+} // namespace
+
+bool event_log::load(fs::path const& path)
+{
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec)) {
+        return false;
+    }
+    try {
+        bip::file_mapping  file(path.string().c_str(), bip::read_only);
+        bip::mapped_region region(file, bip::read_only);
+        auto const*        data = static_cast<char const*>(region.get_address());
+        byte_reader        r { data, data + region.get_size() };
+
+        auto const h = r.pod<header>();
+        if (!r.ok || std::memcmp(h.magic, file_magic, sizeof(file_magic)) != 0
+            || h.format != file_format) {
+            return false;
+        }
+        synths  = get_names(r);
+        samples = get_names(r);
+        if (!r.ok) {
+            return false;
+        }
+        // the log ends at the first incomplete record, the rest of a write cut by a crash
+        while (r.cur != r.end) {
+            auto const kind = record(r.pod<uint8_t>());
+            if (kind == record::mix) {
+                auto name = r.str();
+                if (!r.ok) {
+                    break;
+                }
+                mixes.push_back(std::move(name));
+                continue;
+            }
+            event e;
+            e.time_us = r.pod<int64_t>();
+            e.mix     = r.pod<uint32_t>();
+            e.src     = r.pod<source>();
+            e.osc     = r.str();
+            if (kind != record::sound || !r.ok || e.mix >= mixes.size()) {
+                break;
+            }
+            events.push_back(std::move(e));
+        }
+        return true;
+    }
+    catch (bip::interprocess_exception const&) {
+    }
+    return false;
+}
+
+struct event_log_writer::pimpl {
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point const start = clock::now();
+    std::ofstream           file;
+
+    std::mutex                                mtx;
+    std::condition_variable                   cv;
+    std::condition_variable                   idle;
+    byte_writer                               buffer;
+    std::unordered_map<std::string, uint32_t> mix_ids;
+    bool                                      writing = false;
+    bool                                      failed  = false;
+    bool                                      urgent  = false;
+    bool                                      quit    = false;
+
+    std::thread th;
+
+    pimpl(fs::path const& path, sound_defs const& defs)
+        : file(path, std::ofstream::binary | std::ofstream::trunc)
+    {
+        header h {};
+        std::memcpy(h.magic, file_magic, sizeof(file_magic));
+        h.format = file_format;
+        buffer.pod(h);
+        put_names(buffer, defs.synths());
+        put_names(buffer, defs.samples());
+        failed = !file;
+        th     = std::thread([this] { run(); });
+    }
+
+    ~pimpl()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            quit = true;
+        }
+        cv.notify_one();
+        th.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        for (;;) {
+            cv.wait_for(lk, write_interval, [this] { return quit || urgent; });
+            bool const last = quit;
+            urgent          = false;
+            if (!buffer.out.empty()) {
+                std::string out;
+                out.swap(buffer.out);
+                writing = true;
+                lk.unlock();
+
+                file.write(out.data(), std::streamsize(out.size()));
+                file.flush();
+
+                lk.lock();
+                writing = false;
+                failed  = failed || !file;
+            }
+            idle.notify_all();
+            if (last) {
+                return;
+            }
+        }
+    }
+
+    private:
+    pimpl(pimpl const&) = delete;
+    pimpl& operator=(pimpl const&) = delete;
+};
+
+event_log_writer::event_log_writer(fs::path path, sound_defs const& defs)
+    : _p(std::make_unique<pimpl>(path, defs))
+{
+}
+
+event_log_writer::~event_log_writer()
+{
+}
+
+void event_log_writer::append(std::string const& mix, source src, std::string const& osc)
+{
+    auto const time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                             pimpl::clock::now() - _p->start)
+                             .count();
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lk(_p->mtx);
+        if (_p->failed) {
+            return;
+        }
+        auto& w            = _p->buffer;
+        auto [it, created] = _p->mix_ids.emplace(mix, uint32_t(_p->mix_ids.size()));
+        if (created) {
+            w.pod(record::mix);
+            w.str(mix);
+        }
+        w.pod(record::sound);
+        w.pod(int64_t(time_us));
+        w.pod(it->second);
+        w.pod(src);
+        w.str(osc);
+        wake       = w.out.size() >= write_size && !_p->urgent;
+        _p->urgent = _p->urgent || wake;
+    }
+    if (wake) {
+        _p->cv.notify_one();
+    }
+}
+
+void event_log_writer::flush()
+{
+    std::unique_lock<std::mutex> lk(_p->mtx);
+    _p->urgent = true;
+    _p->cv.notify_one();
+    _p->idle.wait(lk, [this] { return _p->buffer.out.empty() && !_p->writing; });
+}
+
+bool event_log_writer::ok() const
+{
+    std::lock_guard<std::mutex> lk(_p->mtx);
+    return !_p->failed;
+}
\ No newline at end of file
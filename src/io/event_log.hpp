@@ -0,0 +1,55 @@
+#pragma once
+
+#include "chef/ast.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Record of what was sent to the server: every played sound with its time, its mix, the source
+// of its play node and its encoded OSC packet. The file is append only, a crash loses at most
+// the events of the last write interval and a truncated last record is ignored.
+struct event_log {
+    struct event {
+        int64_t     time_us; // since the log was opened
+        uint32_t    mix;     // index in mixes
+        source      src;
+        std::string osc;
+    };
+
+    std::vector<std::string> mixes;
+    std::vector<event>       events;
+
+    // sounds loaded when the log was written, packets refer to them by buffer id
+    std::vector<std::string> synths;
+    std::vector<std::string> samples;
+
+    // false when the file is missing or is not an event log
+    bool load(std::filesystem::path const& path);
+};
+
+// Appends events to a log on a background thread, the caller only copies them to a buffer.
+class event_log_writer {
+    public:
+    // the file is replaced, its header names the loaded sounds
+    event_log_writer(std::filesystem::path path, sound_defs const& defs);
+
+    // buffered events are written before returning
+    ~event_log_writer();
+
+    void append(std::string const& mix, source src, std::string const& osc);
+
+    // writes the buffered events and waits for it
+    void flush();
+
+    // false once a write failed, later events are dropped
+    bool ok() const;
+
+    private:
+    struct pimpl;
+    std::unique_ptr<pimpl> _p;
+    event_log_writer(event_log_writer const&) = delete;
+    event_log_writer& operator=(event_log_writer const&) = delete;
+};
\ No newline at end of file
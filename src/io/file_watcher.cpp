@@ -0,0 +1,177 @@
+#include "io/file_watcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool is_mix(fs::path const& p)
+{
+    return p.extension() == ".dcp";
+}
+
+} // namespace
+
+struct file_watcher::pimpl {
+    fs::path folder;
+
+    std::vector<std::string> changed;
+
+    void add(fs::path const& name)
+    {
+        auto const p = (folder / name).generic_string();
+        if (std::find(changed.begin(), changed.end(), p) == changed.end()) {
+            changed.push_back(p);
+        }
+    }
+
+    fs::path dir() const { return folder.empty() ? fs::path(".") : folder; }
+
+    // every mix of the folder, when events were lost
+    void add_all()
+    {
+        std::error_code ec;
+        for (auto it = fs::directory_iterator(dir(), ec); !ec && it != fs::directory_iterator();
+             it.increment(ec)) {
+            if (is_mix(it->path())) {
+                add(it->path().filename());
+            }
+        }
+    }
+
+#ifdef __linux__
+    int fd = -1;
+    int wd = -1;
+
+    pimpl() { fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC); }
+    ~pimpl()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    void start()
+    {
+        if (fd < 0) {
+            return;
+        }
+        if (wd >= 0) {
+            inotify_rm_watch(fd, wd);
+        }
+        // in place writes end with close, editors and save_worker rename a temp file
+        uint32_t const mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+        wd = inotify_add_watch(fd, dir().c_str(), mask);
+    }
+
+    void read_events()
+    {
+        if (fd < 0) {
+            return;
+        }
+        alignas(inotify_event) char buf[4096];
+        for (;;) {
+            ssize_t const n = read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                return;
+            }
+            for (char const* p = buf; p < buf + n;) {
+                auto const* ev = reinterpret_cast<inotify_event const*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    add_all();
+                }
+                else if (ev->wd == wd && ev->len > 0 && is_mix(ev->name)) {
+                    add(ev->name);
+                }
+            }
+        }
+    }
+#else
+    using clock = std::chrono::steady_clock;
+
+    std::map<std::string, fs::file_time_type> times;
+    clock::time_point                         next_scan;
+
+    pimpl() = default;
+
+    void start()
+    {
+        times.clear();
+        scan();
+        changed.clear();
+    }
+
+    void scan()
+    {
+        std::map<std::string, fs::file_time_type> now;
+        std::error_code                           ec;
+        for (auto it = fs::directory_iterator(dir(), ec); !ec && it != fs::directory_iterator();
+             it.increment(ec)) {
+            if (!is_mix(it->path())) {
+                continue;
+            }
+            auto const name = it->path().filename().generic_string();
+            auto const t    = fs::last_write_time(it->path(), ec);
+            now[name]       = t;
+            auto const prev = times.find(name);
+            if (prev == times.end() || prev->second != t) {
+                add(name);
+            }
+        }
+        for (auto const& t : times) {
+            if (now.find(t.first) == now.end()) {
+                add(t.first);
+            }
+        }
+        times.swap(now);
+    }
+
+    void read_events()
+    {
+        auto const now = clock::now();
+        if (now < next_scan) {
+            return;
+        }
+        next_scan = now + std::chrono::milliseconds(100);
+        scan();
+    }
+#endif
+
+    private:
+    pimpl(pimpl const&) = delete;
+    pimpl& operator=(pimpl const&) = delete;
+};
+
+file_watcher::file_watcher()
+    : _p(std::make_unique<pimpl>())
+{
+}
+
+file_watcher::~file_watcher()
+{
+}
+
+void file_watcher::watch(fs::path const& folder)
+{
+    _p->folder = folder;
+    _p->start();
+    _p->changed.clear();
+}
+
+std::vector<std::string> file_watcher::poll()
+{
+    _p->read_events();
+    std::vector<std::string> res;
+    res.swap(_p->changed);
+    return res;
+}
\ No newline at end of file
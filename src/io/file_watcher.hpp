@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reports the .dcp files of a folder that were written, created, renamed or removed.
+// Uses inotify on Linux and scans the folder a few times per second elsewhere.
+// Writes of files with another extension are ignored, such as save_worker temp files.
+class file_watcher {
+    public:
+    file_watcher();
+    ~file_watcher();
+
+    // stops watching the previous folder
+    void watch(std::filesystem::path const& folder);
+
+    // paths of the files changed since the last poll, each once, never blocks
+    // paths are the folder joined with the file name, as given to watch()
+    std::vector<std::string> poll();
+
+    private:
+    struct pimpl;
+    std::unique_ptr<pimpl> _p;
+    file_watcher(file_watcher const&) = delete;
+    file_watcher& operator=(file_watcher const&) = delete;
+};
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include "io/midi.hpp"
+
+#include "chef/chef.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <queue>
+#include <sstream>
+
+namespace {
+
+// parts of sample names, the first one found gives the note
+std::pair<char const*, int> const gm_drums[] = {
+    { "cymbal_closed", 42 }, { "cymbal_pedal", 44 }, { "cymbal_open", 46 }, { "hat_open", 46 },
+    { "hat", 42 },           { "crash", 49 },        { "ride", 51 },        { "cymbal", 49 },
+    { "tom_hi", 50 },        { "tom_mid", 47 },      { "tom_lo", 41 },      { "tom", 45 },
+    { "snare", 38 },         { "sn_", 38 },          { "clap", 39 },        { "rim", 37 },
+    { "cowbell", 56 },       { "tamb", 54 },         { "kick", 36 },        { "drum_bass", 36 },
+    { "bd_", 36 },
+};
+
+// defaults of the synths, as in sonic-pi
+float const default_note    = 52;
+float const default_release = 1;
+
+// length of a drum hit, a sixteenth
+int const drum_ticks_per_beat = 4;
+
+uint8_t const synth_channel = 0;
+uint8_t const drum_channel  = 9;
+
+int velocity(float amp)
+{
+    return std::clamp(int(std::lround(amp * 100)), 1, 127);
+}
+
+// a track chunk encoded as its events come, written to the file once it ended
+class track_writer {
+    std::string data;
+    uint32_t    last = 0;
+
+    void put(uint8_t b) { data.push_back(char(b)); }
+
+    void put_var(uint32_t v)
+    {
+        uint8_t buf[5];
+        int     n = 0;
+        buf[n++]  = uint8_t(v & 0x7f);
+        while ((v >>= 7) != 0) {
+            buf[n++] = uint8_t(0x80 | (v & 0x7f));
+        }
+        while (n > 0) {
+            put(buf[--n]);
+        }
+    }
+
+    void delta(uint32_t tick)
+    {
+        put_var(tick - last);
+        last = tick;
+    }
+
+    public:
+    void event(uint32_t tick, uint8_t status, uint8_t a, uint8_t b)
+    {
+        delta(tick);
+        put(status);
+        put(a);
+        put(b);
+    }
+
+    void meta(uint32_t tick, uint8_t type, std::string const& data)
+    {
+        delta(tick);
+        put(0xff);
+        put(type);
+        put_var(uint32_t(data.size()));
+        for (auto c : data) {
+            put(uint8_t(c));
+        }
+    }
+
+    void end(uint32_t tick) { meta(std::max(tick, last), 0x2f, {}); }
+
+    void write(std::ofstream& out) const
+    {
+        auto const size   = uint32_t(data.size());
+        char const head[] = { 'M', 'T', 'r', 'k', char(size >> 24), char(size >> 16),
+                              char(size >> 8), char(size) };
+        out.write(head, sizeof(head));
+        out.write(data.data(), std::streamsize(data.size()));
+    }
+};
+
+// the notes of one mix, a note played again before its end is cut there
+struct note_track {
+    using off = std::pair<uint32_t, int>; // tick, channel * 128 + note
+
+    track_writer                                                  t;
+    std::priority_queue<off, std::vector<off>, std::greater<off>> offs;
+    std::array<uint32_t, 16 * 128>                                ends {};
+
+    void note_offs(uint32_t until)
+    {
+        while (!offs.empty() && offs.top().first <= until) {
+            auto const [tick, key] = offs.top();
+            offs.pop();
+            if (ends[size_t(key)] == tick) {
+                ends[size_t(key)] = 0;
+                t.event(tick, uint8_t(0x80 | (key / 128)), uint8_t(key % 128), 0);
+            }
+        }
+    }
+
+    void note_on(uint32_t tick, uint8_t channel, int note, float amp, uint32_t len)
+    {
+        note      = std::clamp(note, 0, 127);
+        auto& end = ends[size_t(channel * 128 + note)];
+        if (end != 0) {
+            t.event(tick, uint8_t(0x80 | channel), uint8_t(note), 0);
+        }
+        t.event(tick, uint8_t(0x90 | channel), uint8_t(note), uint8_t(velocity(amp)));
+        end = tick + std::max(len, 1u);
+        offs.push({ end, channel * 128 + note });
+    }
+};
+
+// the song played from the first measure on a virtual clock, without a server
+struct song_pass {
+    chef ch;
+
+    song_pass(mix_trees const& trees, sound_pool& pool, int tempo)
+        : ch(pool)
+    {
+        ch.trace = false;
+        ch.tempo = tempo;
+        for (auto const& t : trees) {
+            if (t.second) {
+                ch.set_mix(t.first, t.second);
+            }
+        }
+    }
+
+    // calls on_step with the tick of each sub beat once it played, returns the number of ticks
+    template<typename F>
+    uint32_t run(double seconds, F&& on_step)
+    {
+        double   time = 0;
+        uint32_t tick = 0;
+        for (; time < seconds; tick++) {
+            ch.step();
+            on_step(tick);
+            time += 60.0 / std::max(1, ch.tempo) / ch.sub_beats_per_beat;
+        }
+        return tick;
+    }
+
+    private:
+    song_pass(song_pass const&) = delete;
+    song_pass& operator=(song_pass const&) = delete;
+};
+
+} // namespace
+
+drum_map default_drum_map(sound_defs const& defs)
+{
+    drum_map map;
+    for (auto const& name : defs.samples()) {
+        auto const it = std::find_if(std::begin(gm_drums), std::end(gm_drums), [&](auto const& d) {
+            return name.find(d.first) != std::string::npos;
+        });
+        map.push_back(it != std::end(gm_drums) ? it->second : -1);
+    }
+    return map;
+}
+
+bool read_drum_map(std::filesystem::path const& path, sound_defs const& defs, drum_map& map,
+                   std::string& error)
+{
+    std::ifstream f(path);
+    if (!f) {
+        error = "cannot read " + path.generic_string();
+        return false;
+    }
+    auto const& samples = defs.samples();
+    map.resize(samples.size(), -1);
+    std::string line;
+    for (int n = 1; std::getline(f, line); n++) {
+        std::istringstream is(line.substr(0, line.find('#')));
+        std::string        name;
+        int                note = 0;
+        if (!(is >> name)) {
+            continue;
+        }
+        auto const at = "line " + std::to_string(n) + ": ";
+        if (!(is >> note) || note < -1 || note > 127) {
+            error = at + "expected '<sample> <note>'";
+            return false;
+        }
+        auto const it = std::find(samples.begin(), samples.end(), name);
+        if (it == samples.end()) {
+            error = at + "unknown sample '" + name + "'";
+            return false;
+        }
+        map[size_t(it - samples.begin())] = note;
+    }
+    return true;
+}
+
+midi_result write_midi(std::filesystem::path const& path, mix_trees const& trees, sound_pool& pool,
+                       midi_options const& opt)
+{
+    midi_result res;
+    auto        drums = opt.drums.empty() ? default_drum_map(pool.defs()) : opt.drums;
+    drums.resize(pool.defs().samples().size(), -1);
+
+    std::vector<std::string> names;
+    for (auto const& t : trees) {
+        if (t.second) {
+            names.push_back(t.first);
+        }
+    }
+    std::sort(names.begin(), names.end());
+
+    std::ofstream out(path, std::ofstream::binary | std::ofstream::trunc);
+    if (!out) {
+        res.error = "cannot write " + path.generic_string();
+        return res;
+    }
+
+    // a single pass plays every mix, its sounds go to the track of the mix that played them
+    song_pass               p(trees, pool, opt.tempo);
+    track_writer            tempo_track; // with the tempo set by each sub beat
+    std::vector<note_track> tracks(names.size());
+    tempo_track.meta(0, 0x58, { char(p.ch.beats_per_measure), 2, 24, 8 });
+    for (size_t i = 0; i < names.size(); i++) {
+        tracks[i].t.meta(0, 0x03, names[i]);
+    }
+
+    std::vector<std::pair<note_track*, sound_entry const*>> played;
+    p.ch.output = [&](std::string const& mix, sound_entry const& s) {
+        auto const it = std::lower_bound(names.begin(), names.end(), mix);
+        if (it != names.end() && *it == mix) {
+            played.emplace_back(&tracks[size_t(it - names.begin())], &s);
+        }
+    };
+
+    int        tempo = 0;
+    auto const ticks = p.run(opt.seconds, [&](uint32_t tick) {
+        if (p.ch.tempo != tempo) {
+            tempo          = p.ch.tempo;
+            auto const upq = uint32_t(60000000 / std::max(1, tempo));
+            tempo_track.meta(tick, 0x51, { char(upq >> 16), char(upq >> 8), char(upq) });
+        }
+        for (auto& tr : tracks) {
+            tr.note_offs(tick);
+        }
+        auto const ticks_per_second = double(p.ch.tempo) * p.ch.sub_beats_per_beat / 60;
+        for (auto const& [tr, s] : played) {
+            if (auto const* syn = std::get_if<synth>(&s->sound)) {
+                auto const& ps  = syn->params;
+                auto        get = [&](synth::param k, float def) {
+                    return ps.contains(k) ? ps.at(k) : def;
+                };
+                float const secs = get(synth::attack, 0) + get(synth::decay, 0)
+                                   + get(synth::sustain, 0) + get(synth::release, default_release);
+                tr->note_on(tick, synth_channel, int(std::lround(get(synth::note, default_note))),
+                            get(synth::amp, 1), uint32_t(std::lround(secs * ticks_per_second)));
+            }
+            else {
+                auto const& smp  = std::get<sample>(s->sound);
+                int const   note = drums[size_t(smp.id)];
+                if (note < 0) {
+                    res.skipped++;
+                    continue;
+                }
+                float const amp = smp.params.contains(sample::amp) ? smp.params.at(sample::amp)
+                                                                    : 1.f;
+                tr->note_on(tick, drum_channel, note, amp,
+                            uint32_t(p.ch.sub_beats_per_beat / drum_ticks_per_beat));
+            }
+            res.notes++;
+        }
+        played.clear();
+    });
+
+    auto const count    = uint16_t(names.size() + 1);
+    auto const division = uint16_t(p.ch.sub_beats_per_beat);
+    char const header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, char(count >> 8),
+                            char(count), char(division >> 8), char(division) };
+    out.write(header, sizeof(header));
+    tempo_track.end(ticks);
+    tempo_track.write(out);
+    for (auto& tr : tracks) {
+        tr.note_offs(UINT32_MAX);
+        tr.t.end(ticks);
+        tr.t.write(out);
+    }
+
+    out.close();
+    res.ok = !out.fail();
+    if (!res.ok) {
+        res.error = "cannot write " + path.generic_string();
+    }
+    return res;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "parser/parser.hpp"
+#include "soundgen/sound_pool.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// General MIDI drum note of each sample, by sample id, -1 when the sample is not exported
+using drum_map = std::vector<int>;
+
+// notes guessed from the sample names: kick, snare, hats, toms, cymbals...
+drum_map default_drum_map(sound_defs const& defs);
+
+// `<sample> <note>` lines, with # comments, set notes of map; a note of -1 skips the sample
+bool read_drum_map(std::filesystem::path const& path, sound_defs const& defs, drum_map& map,
+                   std::string& error);
+
+struct midi_options {
+    double   seconds = 60; // played from the first measure
+    int      tempo   = 90; // until a mix sets it
+    drum_map drums;        // default_drum_map when empty
+};
+
+struct midi_result {
+    bool        ok      = false;
+    int         notes   = 0;
+    int         skipped = 0; // samples without a drum note
+    std::string error;
+};
+
+// Standard MIDI file, format 1: a tempo track, then one track per mix in name order.
+// Synths play synth::note on channel 1 for the length of their envelope, samples play their
+// drum note on channel 10. A quarter note is a beat, a tick is a sub beat.
+// A single pass of the scheduler on a virtual clock encodes all the tracks, each in its own
+// buffer, they are written to the file once it ended.
+// Transposed sounds are interned in pool.
+midi_result write_midi(std::filesystem::path const& path, mix_trees const& trees, sound_pool& pool,
+                       midi_options const& opt);
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "io/save_worker.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+using save_clock = std::chrono::steady_clock;
+
+struct save_worker::pimpl {
+    struct pending_write {
+        std::string            content;
+        int                    version = 0;
+        save_clock::time_point due;
+    };
+
+    std::chrono::milliseconds const delay;
+
+    std::mutex                           mtx;
+    std::condition_variable              cv;
+    std::condition_variable              idle;
+    std::map<std::string, pending_write> pending;
+    std::deque<result>                   done;
+    bool                                 writing = false;
+    bool                                 quit    = false;
+
+    std::thread th;
+
+    pimpl(std::chrono::milliseconds d)
+        : delay(d)
+        , th([this] { run(); })
+    {
+    }
+
+    ~pimpl()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            quit = true;
+        }
+        cv.notify_one();
+        th.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        for (;;) {
+            if (pending.empty()) {
+                if (quit) {
+                    return;
+                }
+                cv.wait(lk);
+                continue;
+            }
+            auto const next = std::min_element(
+                pending.begin(), pending.end(),
+                [](auto const& a, auto const& b) { return a.second.due < b.second.due; });
+            if (!quit && next->second.due > save_clock::now()) {
+                cv.wait_until(lk, next->second.due);
+                continue;
+            }
+            auto const filename = next->first;
+            auto const w        = std::move(next->second);
+            pending.erase(next);
+            writing = true;
+            lk.unlock();
+
+            result res = write(filename, w);
+
+            lk.lock();
+            writing = false;
+            done.push_back(std::move(res));
+            idle.notify_all();
+        }
+    }
+
+    static result write(std::string const& filename, pending_write const& w)
+    {
+        result res;
+        res.filename = filename;
+        res.version  = w.version;
+
+        std::string const tmp = temp_path(filename);
+        std::error_code   ec;
+        {
+            std::ofstream f(tmp, std::ofstream::trunc);
+            f << w.content;
+            f.close();
+            if (f.fail()) {
+                res.error = "cannot write " + tmp;
+                fs::remove(tmp, ec);
+                return res;
+            }
+        }
+        fs::rename(tmp, filename, ec);
+        if (ec) {
+            res.error = "cannot replace " + filename + ": " + ec.message();
+            fs::remove(tmp, ec);
+            return res;
+        }
+        res.ok = true;
+        return res;
+    }
+
+    private:
+    pimpl(pimpl const&) = delete;
+    pimpl& operator=(pimpl const&) = delete;
+};
+
+save_worker::save_worker(std::chrono::milliseconds delay)
+    : _p(std::make_unique<pimpl>(delay))
+{
+}
+
+save_worker::~save_worker()
+{
+}
+
+void save_worker::submit(std::string filename, std::string content, int version)
+{
+    {
+        std::lock_guard<std::mutex> lk(_p->mtx);
+        auto& w   = _p->pending[std::move(filename)];
+        w.content = std::move(content);
+        w.version = version;
+        w.due     = save_clock::now() + _p->delay;
+    }
+    _p->cv.notify_one();
+}
+
+void save_worker::flush()
+{
+    std::unique_lock<std::mutex> lk(_p->mtx);
+    for (auto& w : _p->pending) {
+        w.second.due = save_clock::time_point::min();
+    }
+    _p->cv.notify_one();
+    _p->idle.wait(lk, [this] { return _p->pending.empty() && !_p->writing; });
+}
+
+void save_worker::cancel(std::string const& filename)
+{
+    std::lock_guard<std::mutex> lk(_p->mtx);
+    _p->pending.erase(filename);
+}
+
+bool save_worker::poll(result& res)
+{
+    std::lock_guard<std::mutex> lk(_p->mtx);
+    if (_p->done.empty()) {
+        return false;
+    }
+    res = std::move(_p->done.front());
+    _p->done.pop_front();
+    return true;
+}
+
+std::string save_worker::temp_path(std::string const& filename)
+{
+    return filename + ".tmp";
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Writes files on a background thread, once their content stopped changing for a delay.
+// Content is written to a temp file next to the target then renamed over it, so a failed
+// or interrupted write never leaves a truncated file.
+class save_worker {
+    public:
+    struct result {
+        std::string filename;
+        int         version = 0;
+        bool        ok      = false;
+        std::string error;
+    };
+
+    explicit save_worker(std::chrono::milliseconds delay = std::chrono::milliseconds(500));
+
+    // pending writes are done before returning
+    ~save_worker();
+
+    // replaces any pending content of the file and restarts its delay
+    void submit(std::string filename, std::string content, int version);
+
+    // writes everything pending now and waits for it
+    void flush();
+
+    // drops the pending content of the file, a write already running still completes
+    void cancel(std::string const& filename);
+
+    // takes the next finished write, never blocks on a running write
+    bool poll(result& res);
+
+    // temp file a content is written to before the rename
+    static std::string temp_path(std::string const& filename);
+
+    private:
+    struct pimpl;
+    std::unique_ptr<pimpl> _p;
+    save_worker(save_worker const&) = delete;
+    save_worker& operator=(save_worker const&) = delete;
+};
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "io/score.hpp"
+
+#include "chef/chef.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+void put_be32(std::string& out, uint32_t v)
+{
+    out.push_back(char(v >> 24));
+    out.push_back(char(v >> 16));
+    out.push_back(char(v >> 8));
+    out.push_back(char(v));
+}
+
+// OSC time tag, seconds then fraction of a second, a score counts from 0
+void put_time(std::string& out, double t)
+{
+    auto const secs = uint32_t(t);
+    put_be32(out, secs);
+    put_be32(out, uint32_t((t - secs) * 4294967296.0));
+}
+
+// scsynth -N reads bundles prefixed by their size
+void put_bundle(std::string& out, double time, std::vector<std::string const*> const& msgs)
+{
+    size_t size = 16;
+    for (auto const* m : msgs) {
+        size += 4 + m->size();
+    }
+    put_be32(out, uint32_t(size));
+    out.append("#bundle", 8);
+    put_time(out, time);
+    for (auto const* m : msgs) {
+        put_be32(out, uint32_t(m->size()));
+        out.append(*m);
+    }
+}
+
+// /c_set 0 0, the usual last command, the render stops at its time
+std::string const end_message("/c_set\0\0,ii\0\0\0\0\0\0\0\0\0", 20);
+
+} // namespace
+
+score_result write_score(std::filesystem::path const& path, mix_trees const& trees,
+                         sound_pool& pool, std::vector<std::string> const& load_packets,
+                         score_options const& opt)
+{
+    score_result res;
+    std::string  out;
+
+    std::vector<std::string const*> msgs;
+    for (auto const& p : load_packets) {
+        msgs.push_back(&p);
+    }
+    put_bundle(out, 0, msgs);
+
+    // sounds are collected for one sub beat, their entries outlive it
+    chef ch(pool);
+    ch.trace  = false;
+    ch.tempo  = opt.tempo;
+    ch.output = [&msgs](std::string const&, sound_entry const& s) { msgs.push_back(&s.osc); };
+    for (auto const& t : trees) {
+        if (t.second) {
+            ch.set_mix(t.first, t.second);
+        }
+    }
+    double time = 0;
+    while (time < opt.seconds) {
+        msgs.clear();
+        ch.step();
+        if (!msgs.empty()) {
+            put_bundle(out, time, msgs);
+            res.sounds += int(msgs.size());
+        }
+        // the next sub beat comes after the tempo set by this one, as in chef::update
+        time += 60.0 / std::max(1, ch.tempo) / ch.sub_beats_per_beat;
+    }
+    res.seconds = time + opt.tail;
+    put_bundle(out, res.seconds, { &end_message });
+
+    std::ofstream f(path, std::ofstream::binary | std::ofstream::trunc);
+    f.write(out.data(), std::streamsize(out.size()));
+    f.close();
+    res.ok = !f.fail();
+    if (!res.ok) {
+        res.error = "cannot write " + path.generic_string();
+    }
+    return res;
+}
\ No newline at end of file
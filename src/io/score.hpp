@@ -0,0 +1,30 @@
+#pragma once
+
+#include "parser/parser.hpp"
+#include "soundgen/sound_pool.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Non realtime score for scsynth: the mixes are played from the first measure on a virtual
+// clock, their sounds are written as timestamped bundles after the sound loading commands.
+// Rendered with `scsynth -N score.osc _ out.wav 48000 WAV int16 -o 2`.
+struct score_options {
+    double seconds = 60; // played from the first measure
+    double tail    = 2;  // after the last sub beat, for the last sounds to ring
+    int    tempo   = 90; // until a mix sets it
+};
+
+struct score_result {
+    bool        ok      = false;
+    int         sounds  = 0;
+    double      seconds = 0; // length of the score, tail included
+    std::string error;
+};
+
+// the score starts with load_packets, soundgen::load_packets for a server to render it
+// transposed sounds are interned in pool
+score_result write_score(std::filesystem::path const& path, mix_trees const& trees,
+                         sound_pool& pool, std::vector<std::string> const& load_packets,
+                         score_options const& opt);
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "io/session.hpp"
+
+#include "parser/ast_io.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+namespace fs  = std::filesystem;
+namespace bip = boost::interprocess;
+
+namespace {
+
+char const     file_magic[4] = { 'D', 'C', 'P', 'S' };
+uint32_t const file_format   = 1;
+
+struct header {
+    char     magic[4];
+    uint32_t format;
+};
+
+void put_names(byte_writer& w, std::vector<std::string> const& names)
+{
+    w.pod(uint32_t(names.size()));
+    for (auto const& n : names) {
+        w.str(n);
+    }
+}
+
+bool same_names(byte_reader& r, std::vector<std::string> const& names)
+{
+    if (r.count(4) != names.size()) {
+        return false;
+    }
+    for (auto const& n : names) {
+        if (r.str() != n) {
+            return false;
+        }
+    }
+    return r.ok;
+}
+
+} // namespace
+
+bool session::load(fs::path const& path, sound_pool& pool)
+{
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec)) {
+        return false;
+    }
+    try {
+        bip::file_mapping  file(path.string().c_str(), bip::read_only);
+        bip::mapped_region region(file, bip::read_only);
+        auto const*        data = static_cast<char const*>(region.get_address());
+        byte_reader        r { data, data + region.get_size() };
+
+        auto const& defs = pool.defs();
+        auto const  h    = r.pod<header>();
+        // trees refer to sounds by id, they are only valid with the same sounds in the same order
+        if (!r.ok || std::memcmp(h.magic, file_magic, sizeof(file_magic)) != 0
+            || h.format != file_format || !same_names(r, defs.synths())
+            || !same_names(r, defs.samples())) {
+            return false;
+        }
+        folder            = r.str();
+        running           = r.pod<uint8_t>() != 0;
+        tempo             = r.pod<int32_t>();
+        beats_per_measure = r.pod<int32_t>();
+        measure           = r.pod<int32_t>();
+        beat              = r.pod<int32_t>();
+        sub_beat          = r.pod<int32_t>();
+        if (tempo <= 0 || beats_per_measure <= 0) {
+            return false;
+        }
+        synths  = defs.synths();
+        samples = defs.samples();
+
+        mixes.resize(r.count(20));
+        for (auto& m : mixes) {
+            m.filename = r.str();
+            m.content  = r.pod<uint64_t>();
+            m.sequences.resize(r.count(12));
+            for (auto& s : m.sequences) {
+                s.id      = r.pod<node_id>();
+                s.start_m = r.pod<int32_t>();
+                s.loops   = r.pod<int32_t>();
+            }
+            auto const  size = r.count(1);
+            auto const* b    = r.bytes(size);
+            byte_reader tr { b, b + size };
+            auto        tree = std::make_shared<ast>();
+            if (!r.ok || !read_ast(tr, *tree, pool) || tr.cur != tr.end) {
+                return false;
+            }
+            m.tree = std::move(tree);
+        }
+        return r.ok;
+    }
+    catch (bip::interprocess_exception const&) {
+    }
+    return false;
+}
+
+struct session_writer::pimpl {
+    fs::path const path;
+
+    std::mutex                 mtx;
+    std::condition_variable    cv;
+    std::condition_variable    idle;
+    std::optional<session>     pending;
+    std::optional<std::string> result; // error of the last finished write, until polled
+    bool                       writing = false;
+    bool                       quit    = false;
+
+    // encoded trees of the last snapshot, by tree, which the value keeps alive
+    std::unordered_map<ast const*, std::pair<ast_ptr, std::string>> encoded;
+
+    std::thread th;
+
+    pimpl(fs::path p)
+        : path(std::move(p))
+        , th([this] { run(); })
+    {
+    }
+
+    ~pimpl()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            quit = true;
+        }
+        cv.notify_one();
+        th.join();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        for (;;) {
+            cv.wait(lk, [this] { return quit || pending; });
+            if (!pending) {
+                return;
+            }
+            session s = std::move(*pending);
+            pending.reset();
+            writing = true;
+            lk.unlock();
+
+            auto error = write(encode(s));
+
+            lk.lock();
+            result  = std::move(error);
+            writing = false;
+            idle.notify_all();
+        }
+    }
+
+    std::string encode(session const& s)
+    {
+        byte_writer w;
+        header      h {};
+        std::memcpy(h.magic, file_magic, sizeof(file_magic));
+        h.format = file_format;
+        w.pod(h);
+        put_names(w, s.synths);
+        put_names(w, s.samples);
+        w.str(s.folder);
+        w.pod(uint8_t(s.running));
+        w.pod(int32_t(s.tempo));
+        w.pod(int32_t(s.beats_per_measure));
+        w.pod(int32_t(s.measure));
+        w.pod(int32_t(s.beat));
+        w.pod(int32_t(s.sub_beat));
+
+        decltype(encoded) kept;
+        w.pod(uint32_t(s.mixes.size()));
+        for (auto const& m : s.mixes) {
+            w.str(m.filename);
+            w.pod(m.content);
+            w.pod(uint32_t(m.sequences.size()));
+            for (auto const& q : m.sequences) {
+                w.pod(q.id);
+                w.pod(int32_t(q.start_m));
+                w.pod(int32_t(q.loops));
+            }
+            auto& e = kept[m.tree.get()];
+            if (auto const prev = encoded.find(m.tree.get()); prev != encoded.end()) {
+                e = std::move(prev->second);
+            }
+            else if (m.tree) {
+                byte_writer tw;
+                write_ast(tw, *m.tree);
+                e = { m.tree, std::move(tw.out) };
+            }
+            w.str(e.second);
+        }
+        encoded.swap(kept);
+        return std::move(w.out);
+    }
+
+    // the error, empty on success
+    std::string write(std::string const& content)
+    {
+        auto            tmp = path;
+        std::error_code ec;
+        tmp += ".tmp";
+        if (path.has_parent_path()) {
+            fs::create_directories(path.parent_path(), ec);
+        }
+        {
+            std::ofstream f(tmp, std::ofstream::binary | std::ofstream::trunc);
+            f.write(content.data(), std::streamsize(content.size()));
+            f.close();
+            if (f.fail()) {
+                fs::remove(tmp, ec);
+                return "cannot write " + tmp.string();
+            }
+        }
+        fs::rename(tmp, path, ec);
+        if (ec) {
+            auto error = "cannot replace " + path.string() + ": " + ec.message();
+            fs::remove(tmp, ec);
+            return error;
+        }
+        return {};
+    }
+
+    private:
+    pimpl(pimpl const&) = delete;
+    pimpl& operator=(pimpl const&) = delete;
+};
+
+session_writer::session_writer(fs::path path)
+    : _p(std::make_unique<pimpl>(std::move(path)))
+{
+}
+
+session_writer::~session_writer()
+{
+}
+
+void session_writer::submit(session s)
+{
+    {
+        std::lock_guard<std::mutex> lk(_p->mtx);
+        _p->pending = std::move(s);
+    }
+    _p->cv.notify_one();
+}
+
+void session_writer::flush()
+{
+    std::unique_lock<std::mutex> lk(_p->mtx);
+    _p->idle.wait(lk, [this] { return !_p->pending && !_p->writing; });
+}
+
+bool session_writer::poll(std::string& error)
+{
+    std::lock_guard<std::mutex> lk(_p->mtx);
+    if (!_p->result) {
+        return false;
+    }
+    error = std::move(*_p->result);
+    _p->result.reset();
+    return true;
+}
\ No newline at end of file
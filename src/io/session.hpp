@@ -0,0 +1,71 @@
+#pragma once
+
+#include "chef/ast.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What is needed to resume a show after a crash or a reboot: the opened folder or file, the
+// compiled tree and sequence positions of each mix, the transport and the sounds the trees were
+// compiled against. A snapshot is one file, memory mapped and checked while it is decoded.
+struct session {
+    // a started sequence, see node_state
+    struct sequence_pos {
+        node_id id;
+        int     start_m;
+        int     loops;
+    };
+
+    struct mix {
+        std::string               filename;
+        uint64_t                  content = 0; // parse_cache::hash of the source of the tree
+        ast_ptr                   tree;
+        std::vector<sequence_pos> sequences;
+    };
+
+    std::string      folder; // empty when a single file was opened
+    std::vector<mix> mixes;
+
+    bool running           = false;
+    int  tempo             = 90;
+    int  beats_per_measure = 4;
+    int  measure           = 1;
+    int  beat              = 1;
+    int  sub_beat          = 0;
+
+    // manifest of the loaded sounds, by buffer id
+    std::vector<std::string> synths;
+    std::vector<std::string> samples;
+
+    // false when the file is missing, corrupt or was made with other sounds than the pool
+    bool load(std::filesystem::path const& path, sound_pool& pool);
+};
+
+// Writes session snapshots on a background thread, only the newest pending one is written.
+// Trees are encoded once, the next snapshots reuse them while they are unchanged.
+// The file is written next to its path then renamed over it, as by save_worker, its folder is
+// created when missing.
+class session_writer {
+    public:
+    explicit session_writer(std::filesystem::path path);
+
+    // the pending snapshot is written before returning
+    ~session_writer();
+
+    void submit(session s);
+
+    // waits for the pending snapshot to be written
+    void flush();
+
+    // takes the result of the last finished write, error is empty when it succeeded
+    // never blocks on a running write
+    bool poll(std::string& error);
+
+    private:
+    struct pimpl;
+    std::unique_ptr<pimpl> _p;
+    session_writer(session_writer const&) = delete;
+    session_writer& operator=(session_writer const&) = delete;
+};
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "soundgen/soundgen.hpp"
 #include "ui/renderer/renderer.hpp"
 
+#ifdef _WIN32
 #include <conio.h>
+#endif
 #include <iostream>
 #include <thread>
 
@@ -13,6 +15,7 @@ try
 #endif
 {
     app app;
+    app.restore();
 
     render_options const opt { 50, 0, 1800, 1000, "dacapo", true };
 
@@ -0,0 +1,333 @@
+#include "parser/ast_io.hpp"
+
+#include <iterator>
+#include <unordered_map>
+
+namespace {
+
+node_range const* children_of(on_beat const& i) { return &i.statements; }
+node_range const* children_of(between_measure const& i) { return &i.statements; }
+node_range const* children_of(sequence const& i) { return &i.statements; }
+node_range const* children_of(repeat const& i) { return &i.statements; }
+node_range const* children_of(every const& i) { return &i.statements; }
+node_range const* children_of(pattern_def const& i) { return &i.statements; }
+template<typename T>
+node_range const* children_of(T const&)
+{
+    return nullptr;
+}
+
+} // namespace
+
+struct ast_io {
+    // sounds are written once, play_sound nodes refer to them by index
+    struct sound_table {
+        std::unordered_map<sound_entry const*, uint32_t> index;
+        std::vector<sound_ptr>                           entries;
+    };
+
+    static void put(byte_writer& w, comment const& i, sound_table&) { w.str(i.text); }
+    static void put(byte_writer&, rest const&, sound_table&) {}
+    static void put(byte_writer& w, affect const& i, sound_table&)
+    {
+        w.str(i.name);
+        w.pod(i.val);
+        w.str(i.expr);
+    }
+    static void put(byte_writer& w, on_beat const& i, sound_table&)
+    {
+        w.pod(int32_t(i.beat));
+        w.pod(int32_t(i.sub_beat));
+        w.pod(int32_t(i.nb_sub));
+        w.pod(i.statements);
+    }
+    static void put(byte_writer& w, between_measure const& i, sound_table&)
+    {
+        w.pod(int32_t(i.m1));
+        w.pod(int32_t(i.m2));
+        w.pod(i.statements);
+    }
+    static void put(byte_writer& w, sequence const& i, sound_table&)
+    {
+        w.pod(int32_t(i.nb_measure));
+        w.pod(i.statements);
+    }
+    static void put(byte_writer& w, repeat const& i, sound_table&)
+    {
+        w.pod(int32_t(i.times));
+        w.pod(i.statements);
+    }
+    static void put(byte_writer& w, every const& i, sound_table&)
+    {
+        w.pod(int32_t(i.period));
+        w.pod(i.statements);
+    }
+    static void put(byte_writer& w, pattern_def const& i, sound_table&)
+    {
+        w.str(i.name);
+        w.pod(i.statements);
+    }
+    static void put(byte_writer& w, pattern_use const& i, sound_table&)
+    {
+        w.str(i.name);
+        w.pod(int32_t(i.transpose));
+        w.pod(int32_t(i.offset));
+    }
+    static void put(byte_writer& w, import_mix const& i, sound_table&) { w.str(i.name); }
+    static void put(byte_writer& w, play_sound const& i, sound_table& sounds)
+    {
+        w.pod(sounds.index.at(i.sound.get()));
+        w.pod(uint32_t(i.exprs.size()));
+        for (auto const& e : i.exprs) {
+            w.pod(int32_t(e.param));
+            w.str(e.text);
+        }
+    }
+
+    static void get(byte_reader& r, comment& i, sound_table const&) { i.text = r.str(); }
+    static void get(byte_reader&, rest&, sound_table const&) {}
+    static void get(byte_reader& r, affect& i, sound_table const&)
+    {
+        i.name = r.str();
+        i.val  = r.pod<float>();
+        i.expr = r.str();
+    }
+    static void get(byte_reader& r, on_beat& i, sound_table const&)
+    {
+        i.beat       = r.pod<int32_t>();
+        i.sub_beat   = r.pod<int32_t>();
+        i.nb_sub     = r.pod<int32_t>();
+        i.statements = r.pod<node_range>();
+        if (i.nb_sub <= 0) {
+            r.ok = false;
+        }
+    }
+    static void get(byte_reader& r, between_measure& i, sound_table const&)
+    {
+        i.m1         = r.pod<int32_t>();
+        i.m2         = r.pod<int32_t>();
+        i.statements = r.pod<node_range>();
+    }
+    static void get(byte_reader& r, sequence& i, sound_table const&)
+    {
+        i.nb_measure = r.pod<int32_t>();
+        i.statements = r.pod<node_range>();
+        if (i.nb_measure <= 0) {
+            r.ok = false;
+        }
+    }
+    static void get(byte_reader& r, repeat& i, sound_table const&)
+    {
+        i.times      = r.pod<int32_t>();
+        i.statements = r.pod<node_range>();
+        if (i.times <= 0) {
+            r.ok = false;
+        }
+    }
+    static void get(byte_reader& r, every& i, sound_table const&)
+    {
+        i.period     = r.pod<int32_t>();
+        i.statements = r.pod<node_range>();
+        if (i.period <= 0) {
+            r.ok = false;
+        }
+    }
+    static void get(byte_reader& r, pattern_def& i, sound_table const&)
+    {
+        i.name       = r.str();
+        i.statements = r.pod<node_range>();
+    }
+    static void get(byte_reader& r, pattern_use& i, sound_table const&)
+    {
+        i.name      = r.str();
+        i.transpose = r.pod<int32_t>();
+        i.offset    = r.pod<int32_t>();
+    }
+    static void get(byte_reader& r, import_mix& i, sound_table const&) { i.name = r.str(); }
+    static void get(byte_reader& r, play_sound& i, sound_table const& sounds)
+    {
+        auto const index = r.pod<uint32_t>();
+        if (index >= sounds.entries.size()) {
+            r.ok = false;
+            return;
+        }
+        i.sound      = sounds.entries[index];
+        auto const n = r.count(8);
+        for (size_t e = 0; e < n && r.ok; e++) {
+            auto const param = r.pod<int32_t>();
+            i.exprs.push_back({ param, r.str() });
+        }
+    }
+
+    template<typename Sound>
+    static void put_sound(byte_writer& w, Sound const& s)
+    {
+        w.pod(int32_t(s.id));
+        w.pod(uint32_t(s.params.size()));
+        for (auto const p : s.params) {
+            w.pod(uint32_t(p.first));
+            w.pod(p.second);
+        }
+    }
+
+    template<typename Sound>
+    static Sound get_sound(byte_reader& r, size_t nb_ids)
+    {
+        Sound s {};
+        s.id = r.pod<int32_t>();
+        if (s.id < 0 || size_t(s.id) >= nb_ids) {
+            r.ok = false;
+        }
+        auto const n = r.count(8, Sound::_nb_params);
+        for (size_t i = 0; i < n; i++) {
+            auto const p = r.pod<uint32_t>();
+            auto const v = r.pod<float>();
+            if (p >= Sound::_nb_params) {
+                r.ok = false;
+                break;
+            }
+            s.params[typename Sound::param(p)] = v;
+        }
+        return s;
+    }
+
+    static void write(byte_writer& w, ast const& a)
+    {
+        sound_table sounds;
+        for (auto const& ps : a.table<play_sound>()) {
+            if (sounds.index.emplace(ps.sound.get(), uint32_t(sounds.entries.size())).second) {
+                sounds.entries.push_back(ps.sound);
+            }
+        }
+        w.pod(uint32_t(sounds.entries.size()));
+        for (auto const& e : sounds.entries) {
+            w.pod(uint8_t(e->sound.index()));
+            std::visit([&w](auto const& s) { put_sound(w, s); }, e->sound);
+        }
+
+        w.pod(uint32_t(a.nodes.size()));
+        for (auto const& n : a.nodes) {
+            w.pod(uint8_t(n.kind));
+            w.pod(n.payload);
+            w.pod(int32_t(n._src.begin));
+            w.pod(int32_t(n._src.end));
+        }
+        w.pod(uint32_t(a.links.size()));
+        for (auto const l : a.links) {
+            w.pod(l);
+        }
+        w.pod(a.root_range);
+        std::apply(
+            [&](auto const&... t) {
+                auto put_table = [&](auto const& tbl) {
+                    w.pod(uint32_t(tbl.size()));
+                    for (auto const& i : tbl) {
+                        put(w, i, sounds);
+                    }
+                };
+                (put_table(t), ...);
+            },
+            a.tables);
+    }
+
+    static bool read(byte_reader& r, ast& a, sound_pool& pool)
+    {
+        auto const& defs = pool.defs();
+        sound_table sounds;
+        auto const  nb_sounds = r.count(5);
+        for (size_t i = 0; i < nb_sounds && r.ok; i++) {
+            auto const kind = r.pod<uint8_t>();
+            if (kind == 0) {
+                sounds.entries.push_back(pool.intern(get_sound<synth>(r, defs.synths().size())));
+            }
+            else if (kind == 1) {
+                sounds.entries.push_back(pool.intern(get_sound<sample>(r, defs.samples().size())));
+            }
+            else {
+                r.ok = false;
+            }
+        }
+
+        auto const nb_nodes = r.count(13);
+        a.nodes.resize(nb_nodes);
+        for (auto& n : a.nodes) {
+            n.kind       = node_kind(r.pod<uint8_t>());
+            n.payload    = r.pod<uint32_t>();
+            n._src.begin = r.pod<int32_t>();
+            n._src.end   = r.pod<int32_t>();
+        }
+        auto const nb_links = r.count(sizeof(node_id));
+        a.links.resize(nb_links);
+        for (auto& l : a.links) {
+            l = r.pod<node_id>();
+        }
+        a.root_range = r.pod<node_range>();
+        std::apply(
+            [&](auto&... t) {
+                auto get_table = [&](auto& tbl) {
+                    tbl.resize(r.count(0, nb_nodes));
+                    for (auto& i : tbl) {
+                        get(r, i, sounds);
+                    }
+                };
+                (get_table(t), ...);
+            },
+            a.tables);
+        return r.ok && valid(a);
+    }
+
+    static bool valid_range(ast const& a, node_range r, size_t parent)
+    {
+        if (r.begin > r.end || r.end > a.links.size()) {
+            return false;
+        }
+        // the parser adds a node before its children, which keeps a cached tree acyclic
+        for (auto i = r.begin; i < r.end; i++) {
+            if (a.links[i] >= a.nodes.size() || a.links[i] <= parent) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool valid(ast const& a)
+    {
+        size_t const sizes[] = { a.table<comment>().size(),     a.table<rest>().size(),
+                                 a.table<affect>().size(),      a.table<on_beat>().size(),
+                                 a.table<play_sound>().size(),  a.table<between_measure>().size(),
+                                 a.table<sequence>().size(),    a.table<repeat>().size(),
+                                 a.table<every>().size(),       a.table<pattern_def>().size(),
+                                 a.table<pattern_use>().size(), a.table<import_mix>().size() };
+        static_assert(std::size(sizes) == std::tuple_size_v<node_types>);
+        for (size_t id = 0; id < a.nodes.size(); id++) {
+            auto const& n = a.nodes[id];
+            if (size_t(n.kind) >= std::size(sizes) || n.payload >= sizes[size_t(n.kind)]) {
+                return false;
+            }
+            auto const* r = a.visit([](auto const& p) { return children_of(p); }, node_id(id));
+            if (r && !valid_range(a, *r, id)) {
+                return false;
+            }
+        }
+        auto const& roots = a.root_range;
+        if (roots.begin > roots.end || roots.end > a.links.size()) {
+            return false;
+        }
+        for (auto i = roots.begin; i < roots.end; i++) {
+            if (a.links[i] >= a.nodes.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+void write_ast(byte_writer& w, ast const& a)
+{
+    ast_io::write(w, a);
+}
+
+bool read_ast(byte_reader& r, ast& a, sound_pool& pool)
+{
+    return ast_io::read(r, a, pool);
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include "chef/ast.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Binary encoding of trees, for the parse cache and the session snapshot.
+// Values are in host byte order, the files are only read back where they were written.
+
+struct byte_writer {
+    std::string out;
+
+    template<typename T>
+    void pod(T const& v)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.append(reinterpret_cast<char const*>(&v), sizeof(T));
+    }
+    void str(std::string const& s)
+    {
+        pod(uint32_t(s.size()));
+        out.append(s);
+    }
+};
+
+// reads are bounds checked, once a read failed ok stays false and values are zeroed
+struct byte_reader {
+    char const* cur;
+    char const* end;
+    bool        ok = true;
+
+    template<typename T>
+    T pod()
+    {
+        T v {};
+        if (!ok || size_t(end - cur) < sizeof(T)) {
+            ok = false;
+            return v;
+        }
+        std::memcpy(&v, cur, sizeof(T));
+        cur += sizeof(T);
+        return v;
+    }
+    char const* bytes(size_t n)
+    {
+        if (!ok || size_t(end - cur) < n) {
+            ok = false;
+            return nullptr;
+        }
+        auto const* b = cur;
+        cur += n;
+        return b;
+    }
+    std::string str()
+    {
+        auto const n = pod<uint32_t>();
+        if (!ok || size_t(end - cur) < n) {
+            ok = false;
+            return {};
+        }
+        std::string s(cur, n);
+        cur += n;
+        return s;
+    }
+    // number of following items, checked against the bytes left when items have a size
+    size_t count(size_t item_size, size_t max = SIZE_MAX)
+    {
+        auto const n = pod<uint32_t>();
+        if (n > max || (item_size > 0 && size_t(end - cur) / item_size < n)) {
+            ok = false;
+        }
+        return ok ? n : 0;
+    }
+};
+
+// sounds are written with the tree, they are interned in pool when it is read
+void write_ast(byte_writer& w, ast const& a);
+
+// false when the data is corrupt
+bool read_ast(byte_reader& r, ast& a, sound_pool& pool);
\ No newline at end of file
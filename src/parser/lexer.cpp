@@ -0,0 +1,197 @@
+#include "parser/lexer.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DACAPO_LEXER_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+enum char_class : uint8_t {
+    cc_invalid = 0,
+    cc_space   = 1 << 0,
+    cc_digit   = 1 << 1,
+    cc_letter  = 1 << 2,
+    cc_under   = 1 << 3,
+    cc_dot     = 1 << 4,
+    cc_quote   = 1 << 5,
+    cc_tilde   = 1 << 6,
+    cc_op      = 1 << 7,
+
+    cc_symbol = cc_letter | cc_digit | cc_under,
+    cc_number = cc_digit | cc_dot,
+};
+
+constexpr std::array<uint8_t, 256> make_classes()
+{
+    std::array<uint8_t, 256> t {};
+    for (char const c : { ' ', '\n', '\r', '\t', '\b', '\v', '\f' }) {
+        t[uint8_t(c)] = cc_space;
+    }
+    for (int c = '0'; c <= '9'; c++) {
+        t[size_t(c)] = cc_digit;
+    }
+    for (int c = 'a'; c <= 'z'; c++) {
+        t[size_t(c)]            = cc_letter;
+        t[size_t(c - 'a' + 'A')] = cc_letter;
+    }
+    for (char const c : { '(', ')', '+', '-', '*', '/', '%', '^', ':', ',' }) {
+        t[uint8_t(c)] = cc_op;
+    }
+    t['_']  = cc_under;
+    t['.']  = cc_dot;
+    t['\''] = cc_quote;
+    t['~']  = cc_tilde;
+    return t;
+}
+
+constexpr std::array<uint8_t, 256> classes = make_classes();
+
+inline uint8_t cls(char c)
+{
+    return classes[uint8_t(c)];
+}
+
+#ifdef DACAPO_LEXER_SSE2
+inline int first_zero_bit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, ~mask);
+    return int(i);
+#else
+    return __builtin_ctz(~mask);
+#endif
+}
+#endif
+
+// skips the common whitespace 16 chars at a time, the table handles the rest
+char const* skip_whitespace(char const* s, char const* e)
+{
+#ifdef DACAPO_LEXER_SSE2
+    __m128i const space = _mm_set1_epi8(' ');
+    __m128i const nl    = _mm_set1_epi8('\n');
+    __m128i const cr    = _mm_set1_epi8('\r');
+    __m128i const tab   = _mm_set1_epi8('\t');
+    while (e - s >= 16) {
+        __m128i const  chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+        __m128i const  ws    = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                                        _mm_cmpeq_epi8(chunk, nl)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(chunk, cr),
+                                                        _mm_cmpeq_epi8(chunk, tab)));
+        unsigned const mask  = unsigned(_mm_movemask_epi8(ws));
+        if (mask != 0xffff) {
+            s += first_zero_bit(mask);
+            break;
+        }
+        s += 16;
+    }
+#endif
+    while (s != e && cls(*s) == cc_space) {
+        ++s;
+    }
+    return s;
+}
+
+char const* scan_digits(char const* s, char const* e)
+{
+    while (s != e && cls(*s) == cc_digit) {
+        ++s;
+    }
+    return s;
+}
+
+} // namespace
+
+void lexer::clear()
+{
+    tokens.clear();
+    eof = token {};
+}
+
+bool lexer::process(std::string_view buffer)
+{
+    char const* const b = buffer.data();
+    char const* const e = b + buffer.size();
+    char const*       s = b;
+
+    tokens.clear();
+    tokens.reserve(buffer.size() / 4);
+    eof = { token::e_eof, std::string_view(e, 0), buffer.size(), buffer.size() };
+
+    auto push = [&](token::token_type type, char const* tb, char const* te) {
+        tokens.push_back(
+            { type, std::string_view(tb, size_t(te - tb)), size_t(tb - b), size_t(te - b) });
+        return type != token::e_error;
+    };
+
+    for (;;) {
+        s = skip_whitespace(s, e);
+        if (s == e) {
+            break;
+        }
+        char const* const tb = s;
+        switch (cls(*s)) {
+        case cc_letter:
+            while (s != e && (cls(*s) & cc_symbol)) {
+                ++s;
+            }
+            push(token::e_symbol, tb, s);
+            break;
+        case cc_digit:
+        case cc_dot: {
+            s = scan_digits(s, e);
+            if (s != e && *s == '.') {
+                s = scan_digits(s + 1, e);
+                if (s != e && *s == '.') {
+                    return push(token::e_error, tb, s + 1);
+                }
+            }
+            if (s != e && (*s == 'e' || *s == 'E')) {
+                char const* x = s + 1;
+                if (x != e && (*x == '+' || *x == '-')) {
+                    ++x;
+                }
+                char const* const xe = scan_digits(x, e);
+                if (xe == x) {
+                    return push(token::e_error, tb, xe);
+                }
+                s = xe;
+            }
+            if (s - tb == 1 && *tb == '.') {
+                return push(token::e_error, tb, s);
+            }
+            push(token::e_number, tb, s);
+            break;
+        }
+        case cc_quote: {
+            char const* const q = static_cast<char const*>(std::memchr(s + 1, '\'', size_t(e - s - 1)));
+            if (!q) {
+                return push(token::e_error, tb + 1, e);
+            }
+            push(token::e_string, tb + 1, q);
+            s = q + 1;
+            break;
+        }
+        case cc_tilde: {
+            char const* const ce = static_cast<char const*>(std::memchr(s, '\n', size_t(e - s)));
+            s                    = ce ? ce : e;
+            push(token::e_comment, tb, s);
+            break;
+        }
+        case cc_op:
+            ++s;
+            push(token::token_type(*tb), tb, s);
+            break;
+        default: return push(token::e_error, tb, s + 1);
+        }
+    }
+    return true;
+}
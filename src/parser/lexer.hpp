@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+struct token {
+    enum token_type {
+        e_none,
+        e_eof,
+        e_error,
+        e_number,
+        e_symbol,
+        e_string,
+        e_comment,
+        e_lbracket = '(',
+        e_rbracket = ')',
+        e_add      = '+',
+        e_sub      = '-',
+        e_mul      = '*',
+        e_div      = '/',
+        e_mod      = '%',
+        e_pow      = '^',
+        e_colon    = ':',
+        e_comma    = ',',
+    };
+
+    token_type type = e_none;
+
+    // view into the lexed buffer, without the quotes for strings, comments keep their '~'
+    std::string_view value;
+
+    size_t position = 0;
+    size_t end      = 0;
+};
+
+// Lexer for the dcp syntax: numbers, 'strings', ~ comments, symbols and operators
+class lexer {
+    std::vector<token> tokens;
+    token              eof;
+
+    public:
+    void clear();
+
+    // returns false if the buffer contains an invalid token, which is then the last one
+    bool process(std::string_view buffer);
+
+    size_t size() const { return tokens.size(); }
+
+    // returns an eof token past the end
+    token const& operator[](size_t i) const { return i < tokens.size() ? tokens[i] : eof; }
+};
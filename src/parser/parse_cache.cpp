@@ -0,0 +1,334 @@
+#include "parser/parse_cache.hpp"
+
+#include "parser/ast_io.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace bip = boost::interprocess;
+
+namespace {
+
+char const     file_magic[4] = { 'D', 'C', 'P', 'C' };
+uint32_t const file_format   = 8;
+
+struct header {
+    char     magic[4];
+    uint32_t format;
+    uint64_t content; // parse_cache::hash of the source
+    uint64_t check;   // parse_cache::check_hash of the source
+    uint64_t sounds;  // sound_defs::version
+    uint64_t size;    // of the source
+};
+
+// 8 bytes per step, a show folder is hashed on every open
+uint64_t hash_with(std::string_view buffer, uint64_t seed, uint64_t mul, uint64_t last)
+{
+    auto mix = [mul](uint64_t h, uint64_t w) {
+        h = (h ^ w) * mul;
+        return h ^ (h >> 32);
+    };
+    uint64_t    h = seed ^ buffer.size();
+    char const* p = buffer.data();
+    size_t      n = buffer.size();
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = mix(h, w);
+    }
+    uint64_t tail = 0;
+    if (n > 0) {
+        std::memcpy(&tail, p, n);
+    }
+    h = mix(h, tail);
+    return mix(h, last);
+}
+
+} // namespace
+
+struct parse_cache::recent_entry {
+    uint64_t                content;
+    uint64_t                check;
+    size_t                  size;
+    ast_ptr                 tree;
+    std::vector<char_type>  char_types;
+    std::vector<mix_import> imports;
+};
+
+parse_cache::parse_cache(sound_pool& pool, std::filesystem::path folder, uint64_t max_size)
+    : pool(pool)
+    , folder(std::move(folder))
+    , max_size(max_size)
+{
+}
+
+std::filesystem::path parse_cache::user_folder()
+{
+    auto env = [](char const* name) {
+        char const* v = std::getenv(name);
+        return std::filesystem::path(v ? v : "");
+    };
+#ifdef _WIN32
+    auto base = env("LOCALAPPDATA");
+#else
+    auto base = env("XDG_CACHE_HOME");
+    if (base.empty() && !env("HOME").empty()) {
+        base = env("HOME") / ".cache";
+    }
+#endif
+    if (base.empty()) {
+        std::error_code ec;
+        base = std::filesystem::temp_directory_path(ec);
+    }
+    return base / "dacapo";
+}
+
+uint64_t parse_cache::hash(std::string_view buffer)
+{
+    return hash_with(buffer, 0x9e3779b97f4a7c15ull, 0xff51afd7ed558ccdull, 0xc4ceb9fe1a85ec53ull);
+}
+
+uint64_t parse_cache::check_hash(std::string_view buffer)
+{
+    return hash_with(buffer, 0x2545f4914f6cdd1dull, 0x9fb21c651e98df25ull, 0x94d049bb133111ebull);
+}
+
+uint64_t parse_cache::entry_key(uint64_t content) const
+{
+    return content ^ (pool.defs().version() * 31);
+}
+
+std::filesystem::path parse_cache::entry_path(uint64_t content) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.dcc", (unsigned long long)entry_key(content));
+    return folder / name;
+}
+
+bool parse_cache::load_recent(parser& prs, uint64_t content, uint64_t check)
+{
+    std::shared_ptr<recent_entry const> e;
+    {
+        std::lock_guard<std::mutex> lock(recent_mutex);
+        auto const                  it = recent_index.find(entry_key(content));
+        if (it == recent_index.end()) {
+            return false;
+        }
+        recent.splice(recent.begin(), recent, it->second);
+        e = recent.front();
+    }
+    if (e->content != content || e->check != check || e->size != prs.buffer.size()
+        || std::any_of(e->imports.begin(), e->imports.end(), [&](mix_import const& i) {
+               return import_hash(i.name, prs.mixes) != i.hash;
+           })) {
+        return false;
+    }
+    prs.tree       = e->tree;
+    prs.char_types = e->char_types;
+    prs.imports    = e->imports;
+    prs.error.clear();
+    prs.line = -1;
+    prs.col  = -1;
+    return true;
+}
+
+void parse_cache::remember(parser const& prs, uint64_t content, uint64_t check)
+{
+    auto e = std::make_shared<recent_entry>(
+        recent_entry { content, check, prs.buffer.size(), prs.tree, prs.char_types, prs.imports });
+    // a sixteenth of the folder size in sources, trees and highlighting take more
+    uint64_t const max_recent = max_size / 16;
+
+    std::lock_guard<std::mutex> lock(recent_mutex);
+    auto const                  key = entry_key(content);
+    if (auto const it = recent_index.find(key); it != recent_index.end()) {
+        recent_size -= (*it->second)->size;
+        recent.erase(it->second);
+    }
+    recent.push_front(std::move(e));
+    recent_index[key] = recent.begin();
+    recent_size += prs.buffer.size();
+    while (recent_size > max_recent && recent.size() > 1) {
+        auto const& last = *recent.back();
+        recent_size -= last.size;
+        recent_index.erase(entry_key(last.content));
+        recent.pop_back();
+    }
+}
+
+bool parse_cache::load(parser& prs)
+{
+    uint64_t const content = hash(prs.buffer);
+    uint64_t const check   = check_hash(prs.buffer);
+    if (load_recent(prs, content, check)) {
+        return true;
+    }
+    auto const      path = entry_path(content);
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return false;
+    }
+    bool hit = false;
+    try {
+        bip::file_mapping  file(path.string().c_str(), bip::read_only);
+        bip::mapped_region region(file, bip::read_only);
+        auto const*        data = static_cast<char const*>(region.get_address());
+        byte_reader             r { data, data + region.get_size() };
+
+        auto const h = r.pod<header>();
+        if (r.ok && std::memcmp(h.magic, file_magic, sizeof(file_magic)) == 0
+            && h.format == file_format && h.content == content
+            && h.sounds == pool.defs().version() && h.size == prs.buffer.size()) {
+            // another source with the same hash
+            if (h.check != check) {
+                return false;
+            }
+            // a tree built against other imports is stale, not corrupt
+            std::vector<mix_import> imports(r.count(12));
+            for (auto& i : imports) {
+                i.name = r.str();
+                i.hash = r.pod<uint64_t>();
+            }
+            if (r.ok && std::any_of(imports.begin(), imports.end(), [&](mix_import const& i) {
+                    return import_hash(i.name, prs.mixes) != i.hash;
+                })) {
+                return false;
+            }
+            std::vector<char_type> char_types(r.count(1, prs.buffer.size()));
+            if (auto const* b = r.bytes(char_types.size())) {
+                // copied as is, then checked in a loop that vectorizes
+                std::memcpy(char_types.data(), b, char_types.size());
+                auto const* u = reinterpret_cast<uint8_t const*>(b);
+                uint8_t     m = 0;
+                for (size_t i = 0; i < char_types.size(); i++) {
+                    m = std::max(m, u[i]);
+                }
+                r.ok = m < uint8_t(char_type::_count);
+            }
+            auto tree = std::make_shared<ast>();
+            if (r.ok && char_types.size() == prs.buffer.size() && read_ast(r, *tree, pool)) {
+                prs.tree = std::move(tree);
+                prs.char_types.swap(char_types);
+                prs.imports.swap(imports);
+                prs.error.clear();
+                prs.line = -1;
+                prs.col  = -1;
+                hit      = true;
+            }
+        }
+    }
+    catch (bip::interprocess_exception const&) {
+    }
+    if (hit) {
+        remember(prs, content, check);
+        // the modification time orders entries for trim
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+        return true;
+    }
+    std::filesystem::remove(path, ec);
+    return false;
+}
+
+void parse_cache::store(parser const& prs)
+{
+    if (!prs.tree || !prs.error.empty() || prs.char_types.size() != prs.buffer.size()) {
+        return;
+    }
+    uint64_t const content = hash(prs.buffer);
+    uint64_t const check   = check_hash(prs.buffer);
+    remember(prs, content, check);
+
+    byte_writer w;
+    header h {};
+    std::memcpy(h.magic, file_magic, sizeof(file_magic));
+    h.format  = file_format;
+    h.content = content;
+    h.check   = check;
+    h.sounds  = pool.defs().version();
+    h.size    = prs.buffer.size();
+    w.pod(h);
+    w.pod(uint32_t(prs.imports.size()));
+    for (auto const& i : prs.imports) {
+        w.str(i.name);
+        w.pod(i.hash);
+    }
+    w.pod(uint32_t(prs.char_types.size()));
+    w.out.append(reinterpret_cast<char const*>(prs.char_types.data()), prs.char_types.size());
+    write_ast(w, *prs.tree);
+
+    std::error_code ec;
+    std::filesystem::create_directories(folder, ec);
+    auto const path = entry_path(content);
+    // two threads may store the same content
+    auto tmp = path;
+    tmp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream f(tmp, std::ofstream::binary | std::ofstream::trunc);
+        f.write(w.out.data(), std::streamsize(w.out.size()));
+        if (!f) {
+            f.close();
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (!ec) {
+        trim(w.out.size());
+    }
+}
+
+void parse_cache::trim(uint64_t stored)
+{
+    namespace fs = std::filesystem;
+    struct entry {
+        fs::path           path;
+        fs::file_time_type time;
+        uint64_t           size;
+    };
+    auto scan = [&] {
+        std::vector<entry> entries;
+        std::error_code    ec;
+        for (fs::directory_iterator it(folder, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->path().extension() == ".dcc") {
+                entries.push_back({ it->path(), it->last_write_time(ec), it->file_size(ec) });
+            }
+        }
+        return entries;
+    };
+    auto total = [](std::vector<entry> const& entries) {
+        int64_t t = 0;
+        for (auto const& e : entries) {
+            t += int64_t(e.size);
+        }
+        return t;
+    };
+
+    std::lock_guard<std::mutex> lock(size_mutex);
+    // a replaced entry is counted twice until the next scan, trimming a bit early
+    size = size < 0 ? total(scan()) : size + int64_t(stored);
+    if (uint64_t(size) <= max_size) {
+        return;
+    }
+    auto entries = scan();
+    std::sort(entries.begin(), entries.end(),
+              [](entry const& a, entry const& b) { return a.time < b.time; });
+    size = total(entries);
+    // down to 3/4 so that a full cache is not scanned on every store
+    std::error_code ec;
+    for (auto const& e : entries) {
+        if (uint64_t(size) <= max_size / 4 * 3) {
+            break;
+        }
+        if (fs::remove(e.path, ec)) {
+            size -= int64_t(e.size);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "parser/parser.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+// On-disk cache of parse results (tree and highlighting), one file per source content.
+// Entries are keyed by a hash of the source and the sound_defs version, so a changed file or
+// sound library simply misses. A second hash of the source is checked on load, so that a
+// collision of the first one is a miss too. Files are memory mapped and checked while being
+// decoded, a corrupt entry is a miss and gets removed. Loads and stores may run on several
+// threads.
+// An entry also keeps the import_hash of each mix its source imports, and misses when one of
+// them changed: the tree holds values of the imported mixes.
+// The results of the last loads and stores are also kept in memory, their trees are shared
+// as they are: opening a folder again skips the files and the decoding.
+class parse_cache {
+    struct recent_entry;
+    using recent_list = std::list<std::shared_ptr<recent_entry const>>;
+
+    sound_pool&           pool;
+    std::filesystem::path folder;
+    uint64_t              max_size;
+    std::mutex            size_mutex;
+    int64_t               size = -1; // of the folder, -1 until first scanned
+
+    std::mutex                                          recent_mutex;
+    recent_list                                         recent;          // most recently used first
+    std::unordered_map<uint64_t, recent_list::iterator> recent_index;    // by entry key
+    uint64_t                                            recent_size = 0; // of their sources
+
+    public:
+    // the least recently used entries are removed when the folder grows over max_size bytes
+    parse_cache(sound_pool& pool, std::filesystem::path folder, uint64_t max_size = 64 << 20);
+
+    // dacapo under the per-user cache folder of the platform
+    static std::filesystem::path user_folder();
+
+    // fills tree and char_types of prs for its buffer, false on a miss
+    bool load(parser& prs);
+
+    // stores the result of a successful parse of prs.buffer
+    void store(parser const& prs);
+
+    static uint64_t hash(std::string_view buffer);
+
+    private:
+    // the second hash, with other constants
+    static uint64_t check_hash(std::string_view buffer);
+
+    uint64_t              entry_key(uint64_t content) const;
+    std::filesystem::path entry_path(uint64_t content) const;
+    void                  trim(uint64_t stored);
+
+    bool load_recent(parser& prs, uint64_t content, uint64_t check);
+    void remember(parser const& prs, uint64_t content, uint64_t check);
+
+    parse_cache(parse_cache const&) = delete;
+    parse_cache& operator=(parse_cache const&) = delete;
+};
\ No newline at end of file
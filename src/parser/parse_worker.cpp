@@ -0,0 +1,160 @@
+#include "parser/parse_worker.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+struct parse_worker::slot_state {
+    std::string           buffer;
+    std::string           filename;
+    mix_trees             mixes;
+    int                   version  = 0;
+    bool                  pending  = false; // a snapshot waits to be parsed
+    bool                  running  = false;
+    bool                  released = false; // the slot is gone, its results are dropped
+    std::optional<result> done;
+};
+
+struct parse_worker::pimpl {
+    std::mutex                              mtx;
+    std::condition_variable                 cv;
+    std::deque<std::shared_ptr<slot_state>> ready; // pending and not running, by submit order
+    bool                                    quit = false;
+
+    std::vector<std::thread> threads;
+
+    // a parser per thread, they share the sounds
+    template<typename Sounds>
+    pimpl(Sounds& sounds, unsigned nb_threads)
+    {
+        for (unsigned i = 0; i < std::max(nb_threads, 1u); i++) {
+            threads.emplace_back([this, &sounds] {
+                parser pars(sounds);
+                run(pars);
+            });
+        }
+    }
+
+    ~pimpl()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            quit = true;
+        }
+        cv.notify_all();
+        for (auto& th : threads) {
+            th.join();
+        }
+    }
+
+    void run(parser& pars)
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        for (;;) {
+            cv.wait(lk, [this] { return quit || !ready.empty(); });
+            if (quit) {
+                return;
+            }
+            auto const s = std::move(ready.front());
+            ready.pop_front();
+            if (s->released) {
+                continue;
+            }
+            pars.buffer.swap(s->buffer);
+            pars.filename.swap(s->filename);
+            pars.mixes.swap(s->mixes);
+            int const version = s->version;
+            s->pending        = false;
+            s->running        = true;
+            lk.unlock();
+
+            bool const ok = pars.parse();
+
+            lk.lock();
+            s->running = false;
+            if (s->released) {
+                continue;
+            }
+            if (s->pending) {
+                ready.push_back(s);
+                continue;
+            }
+            result& res    = s->done.emplace();
+            res.version    = version;
+            res.ok         = ok;
+            res.tree       = std::move(pars.tree);
+            res.char_types = std::move(pars.char_types);
+            res.error      = std::move(pars.error);
+            res.line       = pars.line;
+            res.col        = pars.col;
+            res.imports    = std::move(pars.imports);
+        }
+    }
+
+    private:
+    pimpl(pimpl const&) = delete;
+    pimpl& operator=(pimpl const&) = delete;
+};
+
+parse_worker::parse_worker(sound_defs const& sounds, unsigned threads)
+    : _p(std::make_unique<pimpl>(sounds, threads))
+{
+}
+
+parse_worker::parse_worker(sound_pool& pool, unsigned threads)
+    : _p(std::make_unique<pimpl>(pool, threads))
+{
+}
+
+parse_worker::~parse_worker()
+{
+}
+
+parse_worker::slot::slot(parse_worker& worker)
+    : worker(worker)
+    , state(std::make_shared<slot_state>())
+{
+}
+
+parse_worker::slot::~slot()
+{
+    std::lock_guard<std::mutex> lk(worker._p->mtx);
+    state->released = true;
+}
+
+void parse_worker::slot::submit(std::string buffer, int version, std::string filename,
+                                mix_trees mixes)
+{
+    auto& p = *worker._p;
+    bool  queued;
+    {
+        std::lock_guard<std::mutex> lk(p.mtx);
+        state->buffer.swap(buffer);
+        state->filename.swap(filename);
+        state->mixes.swap(mixes);
+        state->version = version;
+        // a running slot is queued again by its thread when the parse ends
+        queued         = !state->pending && !state->running;
+        state->pending = true;
+        if (queued) {
+            p.ready.push_back(state);
+        }
+    }
+    if (queued) {
+        p.cv.notify_one();
+    }
+}
+
+bool parse_worker::slot::poll(result& res)
+{
+    std::lock_guard<std::mutex> lk(worker._p->mtx);
+    if (!state->done) {
+        return false;
+    }
+    res = std::move(*state->done);
+    state->done.reset();
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "parser/parser.hpp"
+
+#include <memory>
+#include <string>
+
+// Parses buffer snapshots on a few background threads shared by all the buffers.
+// Each buffer submits through its own slot: snapshots submitted while one is waiting or being
+// parsed are coalesced, only the newest is parsed, and a result is dropped if a newer snapshot
+// arrived before it was published. A slot is parsed by one thread at a time.
+class parse_worker {
+    struct slot_state;
+
+    public:
+    struct result {
+        int                     version = 0;
+        bool                    ok      = false;
+        ast_ptr                 tree;
+        std::vector<char_type>  char_types;
+        std::string             error;
+        int                     line = -1;
+        int                     col  = -1;
+        std::vector<mix_import> imports;
+    };
+
+    // the submissions of one buffer, dropped with it, the worker must outlive it
+    class slot {
+        public:
+        slot(parse_worker& worker);
+        ~slot();
+
+        // filename and mixes are given to the parser, for imports
+        void submit(std::string buffer, int version, std::string filename = {},
+                    mix_trees mixes = {});
+
+        // takes the last published result, never blocks on a running parse
+        bool poll(result& res);
+
+        private:
+        parse_worker&               worker;
+        std::shared_ptr<slot_state> state;
+        slot(slot const&) = delete;
+        slot& operator=(slot const&) = delete;
+    };
+
+    parse_worker(sound_defs const& sounds, unsigned threads = 1);
+    parse_worker(sound_pool& pool, unsigned threads = 1);
+    ~parse_worker();
+
+    private:
+    struct pimpl;
+    std::unique_ptr<pimpl> _p;
+    parse_worker(parse_worker const&) = delete;
+    parse_worker& operator=(parse_worker const&) = delete;
+};
\ No newline at end of file
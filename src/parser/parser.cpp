@@ -1,64 +1,107 @@
 #include "parser/parser.hpp"
 
-#include "parser/lexertk.hpp"
+#include "parser/lexer.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <unordered_map>
 
-using token = lexertk::token;
+static int to_int(std::string_view s)
+{
+    int v = 0;
+    std::from_chars(s.data(), s.data() + s.size(), v);
+    return v;
+}
+
+static float to_float(std::string_view s)
+{
+    float v = 0;
+    std::from_chars(s.data(), s.data() + s.size(), v);
+    return v;
+}
+
+// functions usable in values, arguments are separated by spaces: max(root+7 60)
+struct builtin {
+    std::string_view name;
+    size_t           nb_args;
+    float (*fn)(float const*);
+};
+
+static builtin const builtins[] = {
+    { "abs", 1, [](float const* a) { return std::abs(a[0]); } },
+    { "floor", 1, [](float const* a) { return std::floor(a[0]); } },
+    { "ceil", 1, [](float const* a) { return std::ceil(a[0]); } },
+    { "round", 1, [](float const* a) { return std::round(a[0]); } },
+    { "min", 2, [](float const* a) { return std::min(a[0], a[1]); } },
+    { "max", 2, [](float const* a) { return std::max(a[0], a[1]); } },
+};
+
+// midi number of a note name: c4 is 60, fs4 and gb4 are 66
+static bool note_value(std::string_view s, float& v)
+{
+    static int const semitones[] = { 9, 11, 0, 2, 4, 5, 7 }; // a to g
+    if (s.size() < 2 || s[0] < 'a' || s[0] > 'g') {
+        return false;
+    }
+    int    note = semitones[s[0] - 'a'];
+    size_t i    = 1;
+    if (s[i] == 's' || s[i] == 'b') {
+        note += s[i] == 's' ? 1 : -1;
+        i++;
+    }
+    if (i == s.size() || !std::all_of(s.begin() + int(i), s.end(), [](char c) {
+            return c >= '0' && c <= '9';
+        })) {
+        return false;
+    }
+    v = float(12 * (to_int(s.substr(i)) + 1) + note);
+    return true;
+}
 
 char_type tok_char_type(token const& tok)
 {
     switch (tok.type) {
     case token::e_none:
     case token::e_eof: return char_type::none;
-    case token::e_error:
-    case token::e_err_symbol:
-    case token::e_err_number:
-    case token::e_err_string:
-    case token::e_err_sfunc: return char_type::error;
+    case token::e_error: return char_type::error;
     case token::e_number: return char_type::number;
     case token::e_symbol: {
-        if (tok.value == "on")
+        if (tok.value == "on" || tok.value == "seq" || tok.value == "repeat"
+            || tok.value == "every" || tok.value == "def" || tok.value == "use"
+            || tok.value == "import")
             return char_type::keyword;
         else
             return char_type::var;
     }
     case token::e_string: return char_type::str;
-    case token::e_assign:
-    case token::e_shr:
-    case token::e_shl:
-    case token::e_lte:
-    case token::e_ne:
-    case token::e_gte:
-    case token::e_lt:
-    case token::e_gt:
-    case token::e_eq:
-    case token::e_comma:
     case token::e_add:
     case token::e_sub:
     case token::e_div:
     case token::e_mul:
     case token::e_mod:
     case token::e_pow:
-    case token::e_colon: return char_type::op;
+    case token::e_colon:
+    case token::e_comma: return char_type::op;
     case token::e_rbracket:
-    case token::e_lbracket:
-    case token::e_rsqrbracket:
-    case token::e_lsqrbracket:
-    case token::e_rcrlbracket:
-    case token::e_lcrlbracket: return char_type::brack;
+    case token::e_lbracket: return char_type::brack;
     case token::e_comment: return char_type::comment;
     }
     return char_type::none;
 }
 
 struct parser::pimpl {
+    sound_pool&        pool;
     sound_defs const&  sounds;
     std::string const& buffer;
     parser&            result;
     int                curr_line = 0;
 
-    lexertk::generator lexer;
+    lexer lex;
+
+    ast* tree = nullptr;
 
     size_t tok_ind = 0;
 
@@ -81,8 +124,9 @@ struct parser::pimpl {
         result.col  = c;
     }
 
-    pimpl(sound_defs const& sounds, parser& prsng)
-        : sounds(sounds)
+    pimpl(sound_pool& pool, parser& prsng)
+        : pool(pool)
+        , sounds(pool.defs())
         , buffer(prsng.buffer)
         , result(prsng)
     {
@@ -91,27 +135,38 @@ struct parser::pimpl {
     void parse()
     {
         result.error.clear();
+        result.imports.clear();
         result.col  = -1;
         result.line = -1;
-        result.tree.clear();
+        auto next   = std::make_shared<ast>();
+        tree        = next.get();
         result.char_types.resize(result.buffer.size());
 
-        bool const lexok = lex();
+        bool const lexok = lex_buffer();
 
         update_char_types();
 
         if (lexok) {
             update_ast();
         }
+        result.tree = std::move(next);
+        tree        = nullptr;
+    }
+
+    void highlight()
+    {
+        result.char_types.resize(result.buffer.size());
+        lex.process(buffer);
+        update_char_types();
     }
 
     private:
-    bool lex()
+    bool lex_buffer()
     {
-        lexer.clear();
-        if (!lexer.process(buffer)) {
-            if (lexer.size() > 0) {
-                tok_ind = lexer.size() - 1;
+        lex.clear();
+        if (!lex.process(buffer)) {
+            if (lex.size() > 0) {
+                tok_ind = lex.size() - 1;
                 return err("Parse failure");
             }
             return false;
@@ -122,48 +177,66 @@ struct parser::pimpl {
     void update_char_types()
     {
         auto& ctypes = result.char_types;
-        for (size_t i = 0; i < lexer.size(); i++) {
-            auto const& tok = lexer[i];
+        for (size_t i = 0; i < lex.size(); i++) {
+            auto const& tok = lex[i];
             auto const  ct  = tok_char_type(tok);
-            auto        pos = ct == char_type::str || ct == char_type::comment ? tok.position - 1
-                                                                        : tok.position;
-            auto end = ct == char_type::str ? tok.end + 1 : tok.end;
+            auto        pos = ct == char_type::str ? tok.position - 1 : tok.position;
+            auto        end = ct == char_type::str ? tok.end + 1 : tok.end;
             std::fill(ctypes.begin() + int(pos),
                       end >= ctypes.size() ? ctypes.end() : ctypes.begin() + int(end), ct);
         }
     }
     bool update_ast()
     {
-        for (tok_ind = 0; tok_ind < lexer.size(); tok_ind++) {
-            auto const& tok = lexer[tok_ind];
-            if (parse_comment(tok, result.tree))
+        depth     = 0;
+        cur_block = {};
+        constants.clear();
+        child_list roots(*this);
+        for (tok_ind = 0; tok_ind < lex.size(); tok_ind++) {
+            auto const& tok = lex[tok_ind];
+            if (parse_comment(tok, roots.list))
+                continue;
+            if (parse_play(tok, roots.list))
+                continue;
+            if (parse_on_measure(tok, roots.list))
+                continue;
+            if (parse_on_beat(tok, roots.list))
                 continue;
-            if (parse_play(tok, result.tree))
+            if (parse_seq(tok, roots.list))
                 continue;
-            if (parse_on_measure(tok, result.tree))
+            if (parse_repeat(tok, roots.list))
                 continue;
-            if (parse_on_beat(tok, result.tree))
+            if (parse_every(tok, roots.list))
                 continue;
-            if (parse_seq(tok, result.tree))
+            if (parse_import(tok, roots.list))
                 continue;
-            if (parse_affect(tok, result.tree))
+            if (parse_def(tok, roots.list))
+                continue;
+            if (parse_use(tok, roots.list))
+                continue;
+            if (parse_affect(tok, roots.list))
                 continue;
         }
+        tree->set_roots(roots.list);
         return result.error.empty();
     }
 
-    bool is_last() const { return tok_ind + 1 >= lexer.size(); }
+    bool is_last() const { return tok_ind + 1 >= lex.size(); }
 
     bool err(std::string const& e)
     {
-        result.error       = e;
-        auto       tok     = lexer[tok_ind];
-        auto const tok_pos = tok.position;
+        // the first error is reported, callers keep trying alternatives after a failure
+        if (!result.error.empty()) {
+            return false;
+        }
+        result.error        = e;
+        auto const& tok     = lex[tok_ind];
+        auto const  tok_pos = tok.position;
         if (e.empty() && tok.type == token::e_error) {
-            result.error = tok.value;
+            result.error = std::string(tok.value);
         }
         update_res_pos(tok_pos);
-        tok_ind = lexer.size();
+        tok_ind = lex.size();
         return false;
     }
 
@@ -172,26 +245,121 @@ struct parser::pimpl {
     token const& next_token()
     {
         ++tok_ind;
-        return lexer[tok_ind];
+        return lex[tok_ind];
     }
 
     token const* peek_token()
     {
         if (is_last())
             return nullptr;
-        return &lexer[tok_ind + 1];
+        return &lex[tok_ind + 1];
     }
 
-    bool parse_comment(token const& tok, ast& a)
+    // repeat, every and def bodies are the statements on the keyword line or indented below it
+    struct block {
+        size_t line_start = 0;
+        int    indent     = -1; // -1 outside of any block
+    };
+    block cur_block;
+
+    block block_of(token const& tok) const
+    {
+        size_t start = tok.position;
+        while (start > 0 && buffer[start - 1] != '\n') {
+            start--;
+        }
+        size_t end = start;
+        while (end < buffer.size() && (buffer[end] == ' ' || buffer[end] == '\t')) {
+            end++;
+        }
+        return { start, int(end - start) };
+    }
+
+    bool peek_in_block()
+    {
+        auto const* tok = peek_token();
+        if (!tok || cur_block.indent < 0) {
+            return true;
+        }
+        auto const b = block_of(*tok);
+        return b.line_start == cur_block.line_start || b.indent > cur_block.indent;
+    }
+
+    // the next token is one of these keywords
+    bool peek_keyword(std::initializer_list<std::string_view> keywords)
+    {
+        auto const* tok = peek_token();
+        if (!tok || tok->type != token::e_symbol) {
+            return false;
+        }
+        return std::find(keywords.begin(), keywords.end(), tok->value) != keywords.end();
+    }
+
+    using ids = std::vector<node_id>;
+
+    // children being parsed, the lists are reused between containers and parses
+    struct child_list {
+        pimpl& p;
+        ids&   list;
+
+        child_list(pimpl& p)
+            : p(p)
+            , list(p.open_list())
+        {
+        }
+        ~child_list() { p.depth--; }
+
+        private:
+        child_list(child_list const&) = delete;
+        child_list& operator=(child_list const&) = delete;
+    };
+
+    std::deque<ids> lists;
+    size_t          depth = 0;
+
+    ids& open_list()
+    {
+        if (depth == lists.size()) {
+            lists.emplace_back();
+        }
+        ids& l = lists[depth++];
+        l.clear();
+        return l;
+    }
+
+    source src_from(token const& tok) const
+    {
+        return { int(tok.position), int(lex[tok_ind].end) };
+    }
+
+    template<typename T>
+    node_id add(ids& a, token const& tok, T&& payload)
+    {
+        node_id const id = tree->add(std::forward<T>(payload), src_from(tok));
+        a.push_back(id);
+        return id;
+    }
+
+    template<typename T>
+    void close(node_id id, token const& tok, ids const& children)
+    {
+        tree->get<T>(id).statements = tree->add_links(children);
+        tree->set_source(id, src_from(tok));
+    }
+
+    bool parse_comment(token const& tok, ids& a)
     {
         if (tok.type != token::e_comment) {
             return false;
         }
-        a.push_back(comment { tok.value });
+        // the token starts at the '~', the text after its blanks
+        auto text = tok.value.substr(1);
+        text.remove_prefix(std::min(text.find_first_not_of(" \t"), text.size()));
+        add(a, tok, comment { std::string(text) });
         return true;
     }
 
-    bool parse_seq(token const& tok, ast& a)
+    bool parse_seq(token const& tok, ids& a)
     {
         if (tok.type != token::e_symbol || tok.value != "seq") {
             return false;
@@ -201,33 +369,225 @@ struct parser::pimpl {
         }
         auto const& num_tok = next_token();
         if (num_tok.type != token::e_number) {
-            return err("expected number of measure after 'seq', found " + num_tok.value);
+            return err("expected number of measure after 'seq', found "
+                       + std::string(num_tok.value));
         }
-        auto&     st  = a.emplace_back(sequence { std::stoi(num_tok.value) });
-        sequence& seq = std::get<sequence>(st);
+        int const n = to_int(num_tok.value);
+        if (n <= 0) {
+            return err("expected a positive number of measure after 'seq'");
+        }
+        node_id const id = add(a, tok, sequence { n });
+        child_list    seq(*this);
         while (!is_last()) {
-            if (peek_token()->type == token::e_number) {
-                return true;
+            if (peek_token()->type == token::e_number || peek_keyword({ "def" })) {
+                break;
             }
             auto const& ntok = next_token();
-            if (parse_comment(ntok, seq.statements))
+            if (parse_comment(ntok, seq.list))
+                continue;
+            if (parse_play(ntok, seq.list))
+                continue;
+            if (parse_on_beat(ntok, seq.list))
+                continue;
+            if (parse_repeat(ntok, seq.list))
                 continue;
-            if (parse_play(ntok, seq.statements))
+            if (parse_every(ntok, seq.list))
                 continue;
-            if (parse_on_beat(ntok, seq.statements))
+            if (parse_use(ntok, seq.list))
                 continue;
             if (parse_seq(ntok, a))
                 break;
             if (parse_on_measure(ntok, a))
                 break;
-            if (parse_affect(ntok, seq.statements))
+            if (parse_affect(ntok, seq.list))
+                continue;
+        }
+        close<sequence>(id, tok, seq.list);
+        return true;
+    }
+
+    template<typename Loop>
+    bool parse_loop(token const& tok, ids& a, std::string_view keyword)
+    {
+        if (tok.type != token::e_symbol || tok.value != keyword) {
+            return false;
+        }
+        std::string const kw(keyword);
+        if (is_last()) {
+            return err("expected number after '" + kw + "'");
+        }
+        auto const& num_tok = next_token();
+        if (num_tok.type != token::e_number) {
+            return err("expected number after '" + kw + "', found " + std::string(num_tok.value));
+        }
+        int const n = to_int(num_tok.value);
+        if (n <= 0) {
+            return err("expected a positive number after '" + kw + "'");
+        }
+        node_id const id = add(a, tok, Loop { n });
+        parse_block<Loop>(id, tok);
+        return true;
+    }
+    bool parse_repeat(token const& tok, ids& a) { return parse_loop<repeat>(tok, a, "repeat"); }
+    bool parse_every(token const& tok, ids& a) { return parse_loop<every>(tok, a, "every"); }
+
+    // the body ends at a measure number, a seq, a def or a line indented as much as tok
+    template<typename T>
+    void parse_block(node_id id, token const& tok)
+    {
+        block const outer = cur_block;
+        cur_block         = block_of(tok);
+        child_list body(*this);
+        while (!is_last()) {
+            if (peek_token()->type == token::e_number || peek_keyword({ "seq", "def" })
+                || !peek_in_block()) {
+                break;
+            }
+            auto const& ntok = next_token();
+            if (parse_comment(ntok, body.list))
+                continue;
+            if (parse_play(ntok, body.list))
+                continue;
+            if (parse_on_beat(ntok, body.list))
+                continue;
+            if (parse_repeat(ntok, body.list))
+                continue;
+            if (parse_every(ntok, body.list))
+                continue;
+            if (parse_use(ntok, body.list))
+                continue;
+            if (parse_affect(ntok, body.list))
                 continue;
         }
+        close<T>(id, tok, body.list);
+        cur_block = outer;
+    }
 
+    // patterns are only defined at the top level, names are unique in a file
+    bool parse_def(token const& tok, ids& a)
+    {
+        if (tok.type != token::e_symbol || tok.value != "def") {
+            return false;
+        }
+        if (is_last() || peek_token()->type != token::e_symbol) {
+            return err("expected pattern name after 'def'");
+        }
+        std::string name(next_token().value);
+        for (auto const i : a) {
+            if (tree->is<pattern_def>(i) && tree->get<pattern_def>(i).name == name) {
+                return err("pattern '" + name + "' already defined");
+            }
+        }
+        if (is_last() || next_token().type != token::e_colon) {
+            return err("expected ':' after pattern name");
+        }
+        node_id const id = add(a, tok, pattern_def { std::move(name) });
+        parse_block<pattern_def>(id, tok);
         return true;
     }
 
-    bool parse_on_beat(token const& tok, ast& a)
+    // imports are only at the top level, the values set at the top of the imported mix become
+    // usable in the following values
+    bool parse_import(token const& tok, ids& a)
+    {
+        if (tok.type != token::e_symbol || tok.value != "import") {
+            return false;
+        }
+        if (is_last() || peek_token()->type != token::e_string) {
+            return err("expected mix name after 'import'");
+        }
+        std::string name(next_token().value);
+        auto const& mixes = result.mixes;
+        result.imports.push_back({ name, import_hash(name, mixes) });
+
+        auto const self = std::filesystem::path(result.filename).stem().string();
+        auto const mx   = mixes.find(name);
+        if (name == self) {
+            return err("a mix cannot import itself");
+        }
+        if (mx == mixes.end()) {
+            return err("unknown mix '" + name + "'");
+        }
+        if (!mx->second) {
+            return err("mix '" + name + "' has errors");
+        }
+        auto const cycle = import_cycle(self, [&](std::string const& n) {
+            if (n == self) {
+                return std::vector<std::string> { name };
+            }
+            auto const it = mixes.find(n);
+            return it != mixes.end() && it->second ? imported_mixes(*it->second)
+                                                   : std::vector<std::string>();
+        });
+        if (!cycle.empty()) {
+            return err("import cycle " + cycle);
+        }
+
+        auto const& imported = *mx->second;
+        for (auto const id : imported.roots()) {
+            if (imported.is<affect>(id)) {
+                auto const& af     = imported.get<affect>(id);
+                constants[af.name] = af.val;
+            }
+        }
+        add(a, tok, import_mix { std::move(name) });
+        return true;
+    }
+
+    // integer with an optional sign
+    bool parse_int(int& v, std::string const& what)
+    {
+        int sign = 1;
+        if (!is_last() && peek_token()->type == token::e_sub) {
+            next_token();
+            sign = -1;
+        }
+        if (is_last() || peek_token()->type != token::e_number) {
+            return err("expected number after " + what);
+        }
+        v = sign * to_int(next_token().value);
+        return true;
+    }
+
+    bool parse_use(token const& tok, ids& a)
+    {
+        if (tok.type != token::e_symbol || tok.value != "use") {
+            return false;
+        }
+        if (is_last() || peek_token()->type != token::e_symbol) {
+            return err("expected pattern name after 'use'");
+        }
+        pattern_use u { std::string(next_token().value) };
+        if (!is_last() && peek_token()->type == token::e_lbracket) {
+            next_token();
+            while (true) {
+                if (is_last()) {
+                    return err("expected ')'");
+                }
+                auto const& ntok = next_token();
+                if (ntok.type == token::e_rbracket) {
+                    break;
+                }
+                int* const arg = ntok.value == "transpose" ? &u.transpose
+                                 : ntok.value == "offset"  ? &u.offset
+                                                           : nullptr;
+                if (ntok.type != token::e_symbol || !arg) {
+                    return err("invalid pattern argument '" + std::string(ntok.value) + "'");
+                }
+                std::string const name(ntok.value);
+                if (is_last() || next_token().type != token::e_colon) {
+                    return err("expected ':' after '" + name + "'");
+                }
+                if (!parse_int(*arg, "'" + name + ":'")) {
+                    return false;
+                }
+            }
+        }
+        add(a, tok, std::move(u));
+        return true;
+    }
+
+    bool parse_on_beat(token const& tok, ids& a)
     {
         if (tok.type != token::e_symbol || tok.value != "on") {
             return false;
@@ -237,42 +597,45 @@ struct parser::pimpl {
         }
         auto const& num_tok = next_token();
         if (num_tok.type != token::e_number) {
-            return err("expected number after 'on', found " + num_tok.value);
+            return err("expected number after 'on', found " + std::string(num_tok.value));
         }
-        auto&    st = a.emplace_back(on_beat { std::stoi(num_tok.value) });
-        on_beat& ob = std::get<on_beat>(st);
+        on_beat ob { to_int(num_tok.value) };
         if (is_last()) {
             return err("expected something after on beat");
         }
         if (peek_token()->type == token::e_number) {
-            ob.sub_beat = std::stoi(next_token().value);
+            ob.sub_beat = to_int(next_token().value);
             if (is_last() || next_token().type != token::e_div) {
                 return err("expected '/' after sub beat number");
             }
             if (is_last() || peek_token()->type != token::e_number) {
                 return err("expected number after 'subbeat/'");
             }
-            ob.nb_sub = std::stoi(next_token().value);
+            ob.nb_sub = to_int(next_token().value);
         }
+        node_id const id = add(a, tok, ob);
+        child_list    stts(*this);
         while (!is_last()) {
-            if (peek_token()->type == token::e_number) {
-                return true;
+            if (peek_token()->type == token::e_number
+                || peek_keyword({ "seq", "repeat", "every", "def", "use" })
+                || !peek_in_block()) {
+                break;
             }
             auto const& ntok = next_token();
-            if (parse_comment(ntok, ob.statements))
+            if (parse_comment(ntok, stts.list))
                 continue;
-            if (parse_play(ntok, ob.statements))
+            if (parse_play(ntok, stts.list))
                 continue;
             if (parse_on_beat(ntok, a))
                 break;
-            if (parse_affect(ntok, ob.statements))
+            if (parse_affect(ntok, stts.list))
                 continue;
         }
-
+        close<on_beat>(id, tok, stts.list);
         return true;
     }
 
-    bool parse_on_measure(token const& tok, ast& a)
+    bool parse_on_measure(token const& tok, ids& a)
     {
         if (tok.type != token::e_number) {
             return false;
@@ -280,16 +643,15 @@ struct parser::pimpl {
         if (is_last()) {
             return err("expected ':' or '-' after measure number");
         }
-        int const m1 = std::stoi(tok.value);
+        int const m1 = to_int(tok.value);
         int       m2 = m1;
-        ast       suba;
         if (peek_token()->type == token::e_sub) {
             next_token();
             if (is_last()) {
                 return err("expected number or ':' after '-'");
             }
             if (peek_token()->type == token::e_number) {
-                m2 = std::stoi(next_token().value);
+                m2 = to_int(next_token().value);
                 if (m2 < m1) {
                     return err(std::to_string(m2) + " inferior to " + std::to_string(m1));
                 }
@@ -301,30 +663,202 @@ struct parser::pimpl {
         if (next_token().type != token::e_colon) {
             return err("expected ':' after measure number");
         }
-        auto&            st = a.emplace_back(between_measure { m1, m2 });
-        between_measure& bm = std::get<between_measure>(st);
+        node_id const id = add(a, tok, between_measure { m1, m2 });
+        child_list    bm(*this);
         while (!is_last()) {
+            if (peek_keyword({ "def" })) {
+                break;
+            }
             auto const& ntok = next_token();
-            if (parse_comment(ntok, bm.statements))
+            if (parse_comment(ntok, bm.list))
+                continue;
+            if (parse_play(ntok, bm.list))
+                continue;
+            if (parse_on_beat(ntok, bm.list))
                 continue;
-            if (parse_play(ntok, bm.statements))
+            if (parse_seq(ntok, bm.list))
                 continue;
-            if (parse_on_beat(ntok, bm.statements))
+            if (parse_repeat(ntok, bm.list))
                 continue;
-            if (parse_seq(ntok, bm.statements))
+            if (parse_every(ntok, bm.list))
+                continue;
+            if (parse_use(ntok, bm.list))
                 continue;
             if (parse_on_measure(ntok, a))
                 break;
-            if (parse_affect(ntok, bm.statements))
+            if (parse_affect(ntok, bm.list))
                 continue;
         }
+        close<between_measure>(id, tok, bm.list);
+        return true;
+    }
+    // values set by affect statements so far, usable in later values
+    std::unordered_map<std::string, float> constants;
+
+    bool peek_type(token::token_type t)
+    {
+        return !is_last() && peek_token()->type == t;
+    }
+
+    // constant expression, folded to v
+    // when it is more than a number its source is kept in text, for printing
+    // what names the value in errors, it is only built on failure
+    template<typename What>
+    bool parse_value(float& v, std::string& text, What const& what)
+    {
+        if (is_last()) {
+            return err("expected value after " + what());
+        }
+        auto const t = peek_token()->type;
+        if (t != token::e_number && t != token::e_symbol && t != token::e_lbracket
+            && t != token::e_sub) {
+            return err("expected number after " + what());
+        }
+        size_t const first = tok_ind + 1;
+        if (!parse_sum(v)) {
+            return false;
+        }
+        // pow overflows or has no real result, a float param cannot hold it
+        if (!std::isfinite(v)) {
+            return err("value of " + what() + " is not a finite number");
+        }
+        if (tok_ind != first || lex[first].type != token::e_number) {
+            auto const b = lex[first].position;
+            text         = buffer.substr(b, lex[tok_ind].end - b);
+        }
+        return true;
+    }
+
+    bool parse_sum(float& v)
+    {
+        if (!parse_product(v)) {
+            return false;
+        }
+        while (peek_type(token::e_add) || peek_type(token::e_sub)) {
+            bool const add = next_token().type == token::e_add;
+            float      r   = 0;
+            if (!parse_product(r)) {
+                return false;
+            }
+            v = add ? v + r : v - r;
+        }
+        return true;
+    }
+
+    bool parse_product(float& v)
+    {
+        if (!parse_unary(v)) {
+            return false;
+        }
+        while (peek_type(token::e_mul) || peek_type(token::e_div) || peek_type(token::e_mod)) {
+            auto const op = next_token().type;
+            float      r  = 0;
+            if (!parse_unary(r)) {
+                return false;
+            }
+            if (op != token::e_mul && r == 0) {
+                return err("division by zero");
+            }
+            v = op == token::e_mul ? v * r : op == token::e_div ? v / r : std::fmod(v, r);
+        }
+        return true;
+    }
+
+    bool parse_unary(float& v)
+    {
+        if (peek_type(token::e_sub)) {
+            next_token();
+            if (!parse_unary(v)) {
+                return false;
+            }
+            v = -v;
+            return true;
+        }
+        if (!parse_primary(v)) {
+            return false;
+        }
+        if (peek_type(token::e_pow)) {
+            next_token();
+            float r = 0;
+            if (!parse_unary(r)) {
+                return false;
+            }
+            v = std::pow(v, r);
+        }
         return true;
     }
+
+    bool parse_primary(float& v)
+    {
+        if (is_last()) {
+            return err("expected value");
+        }
+        auto const& tok = next_token();
+        if (tok.type == token::e_number) {
+            v = to_float(tok.value);
+            return true;
+        }
+        if (tok.type == token::e_lbracket) {
+            if (!parse_sum(v)) {
+                return false;
+            }
+            if (!peek_type(token::e_rbracket)) {
+                return err("expected ')'");
+            }
+            next_token();
+            return true;
+        }
+        if (tok.type != token::e_symbol) {
+            return err("expected value, found '" + std::string(tok.value) + "'");
+        }
+        std::string const name(tok.value);
+        if (peek_type(token::e_lbracket)) {
+            return parse_call(name, v);
+        }
+        if (auto const c = constants.find(name); c != constants.end()) {
+            v = c->second;
+            return true;
+        }
+        if (note_value(name, v)) {
+            return true;
+        }
+        return err("unknown value '" + name + "'");
+    }
+
+    bool parse_call(std::string const& name, float& v)
+    {
+        auto const fn = std::find_if(std::begin(builtins), std::end(builtins),
+                                     [&](builtin const& b) { return b.name == name; });
+        if (fn == std::end(builtins)) {
+            return err("unknown function '" + name + "'");
+        }
+        next_token();
+        float  args[2] = {};
+        size_t n       = 0;
+        // separated by commas, "max(1 -2)" would be a single argument
+        while (!peek_type(token::e_rbracket)) {
+            if (n == fn->nb_args) {
+                return err("too many arguments for '" + name + "'");
+            }
+            if (n > 0 && (is_last() || next_token().type != token::e_comma)) {
+                return err("expected ',' between the arguments of '" + name + "'");
+            }
+            if (!parse_sum(args[n++])) {
+                return false;
+            }
+        }
+        next_token();
+        if (n != fn->nb_args) {
+            return err("expected " + std::to_string(fn->nb_args) + " arguments for '" + name
+                       + "'");
+        }
+        v = fn->fn(args);
+        return true;
+    }
+
     template<typename Sound>
-    bool parse_sound_args(int id, std::string const& name, play_sound& ps)
+    bool parse_sound_args(Sound& s, std::vector<param_expr>& exprs)
     {
-        ps.sound = Sound { id, name };
-        Sound& s = std::get<Sound>(ps.sound);
         if (is_last() || peek_token()->type != token::e_lbracket) {
             return true;
         }
@@ -334,67 +868,66 @@ struct parser::pimpl {
             if (ntok.type == token::e_rbracket) {
                 return true;
             }
-            int param = -1;
             if (ntok.type != token::e_symbol) {
-                return err("invalid param name '" + ntok.value + "'");
-            }
-            for (int i = 0; i < Sound::_nb_params; i++) {
-                if (Sound::param_name(Sound::param(i)) == ntok.value) {
-                    param = i;
-                    break;
-                }
+                return err("invalid param name '" + std::string(ntok.value) + "'");
             }
+            int const param = Sound::find_param(ntok.value);
             if (param == -1) {
-                return err("invalid param name '" + ntok.value + "'");
+                return err("invalid param name '" + std::string(ntok.value) + "'");
             }
+            auto const what = [&ntok] { return "param '" + std::string(ntok.value) + "'"; };
             if (is_last() || next_token().type != token::e_colon) {
-                return err("expected ':' after param '" + ntok.value + "'");
+                return err("expected ':' after " + what());
             }
-            if (is_last()) {
-                return err("expected value after param '" + ntok.value + "'");
+            float       val = 0;
+            std::string text;
+            if (!parse_value(val, text, what)) {
+                return false;
             }
-            auto const& nt = next_token();
-            if (nt.type != token::e_number) {
-                return err("expected number after param '" + ntok.value + "'");
+            s.params[typename Sound::param(param)] = val;
+            if (!text.empty()) {
+                exprs.push_back({ param, std::move(text) });
             }
-            s.params[Sound::param(param)] = std::stof(nt.value);
         }
         return err("expected ')'");
     }
-    bool parse_play(token const& tok, ast& a)
+    template<typename Sound>
+    bool parse_sound(token const& tok, ids& a, int id)
+    {
+        Sound                   s { id };
+        std::vector<param_expr> exprs;
+        bool const              ok = parse_sound_args(s, exprs);
+        add(a, tok, play_sound { pool.intern(std::move(s)), std::move(exprs) });
+        return ok;
+    }
+    bool parse_play(token const& tok, ids& a)
     {
         if (tok.type != token::e_string) {
             return false;
         }
-        auto&       st = a.emplace_back(play_sound {});
-        play_sound& ps = std::get<play_sound>(st);
-
-        for (size_t i = 0; i < sounds.synths.size(); i++) {
-            if (sounds.synths[i] == tok.value) {
-                return parse_sound_args<synth>(int(i), tok.value, ps);
-            }
+        auto const ref = sounds.find(tok.value);
+        if (!ref) {
+            return err("no synth or sample found with name '" + std::string(tok.value) + "'");
         }
-        for (size_t i = 0; i < sounds.samples.size(); i++) {
-            if (sounds.samples[i] == tok.value) {
-                return parse_sound_args<sample>(int(i), tok.value, ps);
-            }
+        if (ref->kind == sound_kind::synth) {
+            return parse_sound<synth>(tok, a, ref->id);
         }
-        return err("no synth or sample found with name '" + tok.value + "'");
+        return parse_sound<sample>(tok, a, ref->id);
     }
 
-    bool parse_affect(token const& tok, ast& a)
+    bool parse_affect(token const& tok, ids& a)
     {
         if (tok.type != token::e_symbol) {
             return false;
         }
-        if (is_last()) {
-            return err("expected value after " + tok.value);
-        }
-        auto const& nt = next_token();
-        if (nt.type != token::e_number) {
-            return err("expected number after " + tok.value);
+        std::string name(tok.value);
+        float       val = 0;
+        std::string text;
+        if (!parse_value(val, text, [&name] { return name; })) {
+            return false;
         }
-        a.push_back({ affect { tok.value, std::stof(nt.value) } });
+        constants[name] = val;
+        add(a, tok, affect { std::move(name), val, std::move(text) });
         return true;
     }
 
@@ -403,9 +936,57 @@ struct parser::pimpl {
     pimpl& operator=(pimpl const&) = delete;
 };
 
+static uint64_t import_hash(std::string const& name, mix_trees const& mixes,
+                            std::vector<std::string>& visiting)
+{
+    auto const mx = mixes.find(name);
+    if (mx == mixes.end() || !mx->second
+        || std::find(visiting.begin(), visiting.end(), name) != visiting.end()) {
+        return 0;
+    }
+    // fnv-1a, stable across runs as parse_cache entries keep it
+    uint64_t h   = 0xcbf29ce484222325ull;
+    auto     add = [&h](void const* p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            h = (h ^ static_cast<unsigned char const*>(p)[i]) * 0x100000001b3ull;
+        }
+    };
+    auto const& tree = *mx->second;
+    visiting.push_back(name);
+    for (auto const id : tree.roots()) {
+        if (tree.is<affect>(id)) {
+            auto const& af = tree.get<affect>(id);
+            add(af.name.data(), af.name.size() + 1);
+            add(&af.val, sizeof(af.val));
+        }
+        else if (tree.is<import_mix>(id)) {
+            auto const&    im  = tree.get<import_mix>(id);
+            uint64_t const sub = import_hash(im.name, mixes, visiting);
+            add(im.name.data(), im.name.size() + 1);
+            add(&sub, sizeof(sub));
+        }
+    }
+    visiting.pop_back();
+    return h == 0 ? 1 : h;
+}
+
+uint64_t import_hash(std::string const& name, mix_trees const& mixes)
+{
+    std::vector<std::string> visiting;
+    return import_hash(name, mixes, visiting);
+}
+
 parser::parser(sound_defs const& sounds)
+    : tree(std::make_shared<ast>())
+    , _own_pool(std::make_unique<sound_pool>(sounds))
+{
+    _p = std::make_unique<pimpl>(*_own_pool, *this);
+}
+
+parser::parser(sound_pool& pool)
+    : tree(std::make_shared<ast>())
 {
-    _p = std::make_unique<pimpl>(sounds, *this);
+    _p = std::make_unique<pimpl>(pool, *this);
 }
 
 parser::~parser()
@@ -415,12 +996,10 @@ parser::~parser()
 bool parser::parse()
 {
     _p->parse();
-    if (error.empty()) {
-        std::cout << "Parse ok" << std::endl;
-        return true;
-    }
-    else {
-        std::cerr << "Parse failed: " << line << ":" << col << " " << error << std::endl;
-        return false;
-    }
+    return error.empty();
+}
+
+void parser::highlight()
+{
+    _p->highlight();
 }
\ No newline at end of file
@@ -3,24 +3,98 @@
 #include "chef/ast.hpp"
 
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-enum class char_type { none, number, keyword, var, str, op, brack, comment, error, _count };
+// a byte per char of the buffer, the parse cache copies them as they are
+enum class char_type : uint8_t {
+    none,
+    number,
+    keyword,
+    var,
+    str,
+    op,
+    brack,
+    comment,
+    error,
+    _count
+};
+
+// mixes of a folder by name, with their last good tree, null when they have none
+using mix_trees = std::unordered_map<std::string, ast_ptr>;
+
+// a mix imported by a parse, with the import_hash it was compiled against
+struct mix_import {
+    std::string name;
+    uint64_t    hash = 0;
+};
+
+// changes when what importing the mix gives changes: its top level values and its imports,
+// transitively. 0 when the mix is unknown or has no tree
+uint64_t import_hash(std::string const& name, mix_trees const& mixes);
+
+// imports leading from a mix back to itself as "a -> b -> a", empty when there is none
+// imports_of(name) gives the names imported by a mix
+template<typename ImportsOf>
+std::string import_cycle(std::string const& name, ImportsOf const& imports_of)
+{
+    std::vector<std::string>        path { name };
+    std::unordered_set<std::string> seen; // mixes already known not to lead back
+    auto walk = [&](auto& self, std::string const& from) -> bool {
+        for (auto const& next : imports_of(from)) {
+            if (next == name) {
+                path.push_back(next);
+                return true;
+            }
+            if (!seen.insert(next).second) {
+                continue;
+            }
+            path.push_back(next);
+            if (self(self, next)) {
+                return true;
+            }
+            path.pop_back();
+        }
+        return false;
+    };
+    std::string res;
+    if (walk(walk, name)) {
+        for (auto const& p : path) {
+            res += (res.empty() ? "" : " -> ") + p;
+        }
+    }
+    return res;
+}
 
 struct parser {
-    std::string            filename;
+    std::string            filename; // its stem is the mix name, for imports
     std::string            buffer;
-    ast                    tree;
+    ast_ptr                tree;
     std::vector<char_type> char_types;
     std::string            error;
     int                    line = -1;
     int                    col  = -1;
 
+    // mixes the buffer can import, set before parsing
+    mix_trees mixes;
+
+    // mixes imported by the last parse, up to its error if it failed
+    std::vector<mix_import> imports;
+
+    // sounds are interned in a pool private to the parser
     parser(sound_defs const& sounds);
+    parser(sound_pool& pool);
     ~parser();
 
     bool parse();
 
+    // only lexes the buffer and updates char_types
+    void highlight();
+
     private:
+    std::unique_ptr<sound_pool> _own_pool;
     struct pimpl;
     std::unique_ptr<pimpl> _p;
     parser(parser const&) = delete;
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace param_bits {
+
+inline size_t popcount(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return size_t((x * 0x0101010101010101ull) >> 56);
+}
+
+// x must not be 0
+inline size_t lowest_bit(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return size_t(i);
+#else
+    return size_t(__builtin_ctzll(x));
+#endif
+}
+
+} // namespace param_bits
+
+// Values of the params set on a sound: a presence bitmask and a fixed array of values indexed by
+// param, inline so a sound needs no allocation. Iteration gives the present params in param order,
+// which is the OSC argument order. Absent params keep a value of 0.
+template<typename Param, size_t N>
+class param_set {
+    static constexpr size_t nb_words = (N + 63) / 64;
+
+    std::array<uint64_t, nb_words> mask {};
+    std::array<float, N>           values {};
+
+    static size_t   word(Param p) { return size_t(p) / 64; }
+    static uint64_t bit(Param p) { return uint64_t(1) << (size_t(p) % 64); }
+
+    public:
+    param_set() = default;
+    param_set(std::initializer_list<std::pair<Param, float>> init)
+    {
+        for (auto const& p : init) {
+            (*this)[p.first] = p.second;
+        }
+    }
+
+    class const_iterator {
+        param_set const* set  = nullptr;
+        size_t           w    = nb_words;
+        uint64_t         bits = 0;
+
+        void skip_empty()
+        {
+            while (bits == 0 && ++w < nb_words) {
+                bits = set->mask[w];
+            }
+        }
+
+        public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::pair<Param, float>;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = value_type;
+
+        const_iterator() = default;
+        explicit const_iterator(param_set const& s)
+            : set(&s)
+            , w(0)
+            , bits(s.mask[0])
+        {
+            skip_empty();
+        }
+
+        value_type operator*() const
+        {
+            auto const p = w * 64 + param_bits::lowest_bit(bits);
+            return { Param(p), set->values[p] };
+        }
+        const_iterator& operator++()
+        {
+            bits &= bits - 1;
+            skip_empty();
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            auto prev = *this;
+            ++*this;
+            return prev;
+        }
+        bool operator==(const_iterator const& o) const { return w == o.w && bits == o.bits; }
+        bool operator!=(const_iterator const& o) const { return !(*this == o); }
+    };
+
+    bool contains(Param p) const { return (mask[word(p)] & bit(p)) != 0; }
+
+    // adds the param with a value of 0 if it is not set
+    float& operator[](Param p)
+    {
+        mask[word(p)] |= bit(p);
+        return values[size_t(p)];
+    }
+
+    float at(Param p) const
+    {
+        if (!contains(p)) {
+            throw std::out_of_range("param not set");
+        }
+        return values[size_t(p)];
+    }
+
+    void erase(Param p)
+    {
+        mask[word(p)] &= ~bit(p);
+        values[size_t(p)] = 0;
+    }
+
+    size_t size() const
+    {
+        size_t n = 0;
+        for (auto const m : mask) {
+            n += param_bits::popcount(m);
+        }
+        return n;
+    }
+    bool empty() const { return mask == decltype(mask) {}; }
+
+    void clear()
+    {
+        mask   = {};
+        values = {};
+    }
+
+    const_iterator begin() const { return const_iterator(*this); }
+    const_iterator end() const { return {}; }
+
+    bool operator==(param_set const& o) const { return mask == o.mask && values == o.values; }
+    bool operator!=(param_set const& o) const { return !(*this == o); }
+};
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+
+// Bidirectional param <-> name table, sorted by name at compile time
+template<typename Param, size_t N>
+class param_table {
+    std::array<std::string_view, N> names {};
+    std::array<Param, N>            by_name {};
+
+    public:
+    constexpr param_table(std::string_view const (&n)[N])
+    {
+        for (size_t i = 0; i < N; i++) {
+            names[i] = n[i];
+            size_t j = i;
+            for (; j > 0 && names[size_t(by_name[j - 1])] > names[i]; j--) {
+                by_name[j] = by_name[j - 1];
+            }
+            by_name[j] = Param(i);
+        }
+    }
+
+    // every param must have a distinct name for lookups to be unambiguous
+    constexpr bool valid() const
+    {
+        for (size_t i = 0; i < N; i++) {
+            if (names[i].empty()) {
+                return false;
+            }
+            if (i > 0 && names[size_t(by_name[i - 1])] == names[size_t(by_name[i])]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    constexpr std::string_view name(Param p) const { return names[size_t(p)]; }
+
+    // returns -1 if no param has this name
+    constexpr int find(std::string_view n) const
+    {
+        size_t lo = 0;
+        size_t hi = N;
+        while (lo < hi) {
+            size_t const mid = (lo + hi) / 2;
+            int const    cmp = names[size_t(by_name[mid])].compare(n);
+            if (cmp == 0) {
+                return int(by_name[mid]);
+            }
+            if (cmp < 0) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return -1;
+    }
+};
@@ -1,107 +1,121 @@
 #include "soundgen/sample.hpp"
 
-const char* sample::param_name(sample::param p)
+#include "soundgen/param_table.hpp"
+
+static constexpr param_table<sample::param, sample::_nb_params> params_table({
+    "amp",
+    "amp_slide",
+    "amp_slide_shape",
+    "amp_slide_curve",
+    "pan",
+    "pan_slide",
+    "pan_slide_shape",
+    "pan_slide_curve",
+    "attack",
+    "decay",
+    "sustain",
+    "release",
+    "attack_level",
+    "decay_level",
+    "sustain_level",
+    "env_curve",
+    "rate",
+    "start",
+    "finish",
+    "lpf",
+    "lpf_slide",
+    "lpf_slide_shape",
+    "lpf_slide_curve",
+    "lpf_attack",
+    "lpf_sustain",
+    "lpf_decay",
+    "lpf_release",
+    "lpf_min",
+    "lpf_min_slide",
+    "lpf_min_slide_shape",
+    "lpf_min_slide_curve",
+    "lpf_init_level",
+    "lpf_attack_level",
+    "lpf_decay_level",
+    "lpf_sustain_level",
+    "lpf_release_level",
+    "lpf_env_curve",
+    "hpf",
+    "hpf_slide",
+    "hpf_slide_shape",
+    "hpf_slide_curve",
+    "hpf_max",
+    "hpf_max_slide",
+    "hpf_max_slide_shape",
+    "hpf_max_slide_curve",
+    "hpf_attack",
+    "hpf_sustain",
+    "hpf_decay",
+    "hpf_release",
+    "hpf_init_level",
+    "hpf_attack_level",
+    "hpf_decay_level",
+    "hpf_sustain_level",
+    "hpf_release_level",
+    "hpf_env_curve",
+    "norm",
+    "pitch",
+    "pitch_slide",
+    "pitch_slide_shape",
+    "pitch_slide_curve",
+    "window_size",
+    "window_size_slide",
+    "window_size_slide_shape",
+    "window_size_slide_curve",
+    "pitch_dis",
+    "pitch_dis_slide",
+    "pitch_dis_slide_shape",
+    "pitch_dis_slide_curve",
+    "time_dis",
+    "time_dis_slide",
+    "time_dis_slide_shape",
+    "time_dis_slide_curve",
+    "compress",
+    "pre_amp",
+    "pre_amp_slide",
+    "pre_amp_slide_shape",
+    "pre_amp_slide_curve",
+    "threshold",
+    "threshold_slide",
+    "threshold_slide_shape",
+    "threshold_slide_curve",
+    "clamp_time",
+    "clamp_time_slide",
+    "clamp_time_slide_shape",
+    "clamp_time_slide_curve",
+    "slope_above",
+    "slope_above_slide",
+    "slope_above_slide_shape",
+    "slope_above_slide_curve",
+    "slope_below",
+    "slope_below_slide",
+    "slope_below_slide_shape",
+    "slope_below_slide_curve",
+    "relax_time",
+    "relax_time_slide",
+    "relax_time_slide_shape",
+    "relax_time_slide_curve",
+    "out_bus",
+});
+
+static_assert(params_table.valid());
+static_assert(params_table.find("out_bus") == sample::out_bus);
+static_assert(params_table.find("unknown") == -1);
+
+const char* sample::param_name(param p)
 {
-    switch (p) {
-    case amp: return "amp";
-    case amp_slide: return "amp_slide";
-    case amp_slide_shape: return "amp_slide_shape";
-    case amp_slide_curve: return "amp_slide_curve";
-    case pan: return "pan";
-    case pan_slide: return "pan_slide";
-    case pan_slide_shape: return "pan_slide_shape";
-    case pan_slide_curve: return "pan_slide_curve";
-    case attack: return "attack";
-    case decay: return "decay";
-    case sustain: return "sustain";
-    case release: return "release";
-    case attack_level: return "attack_level";
-    case decay_level: return "decay_level";
-    case sustain_level: return "sustain_level";
-    case env_curve: return "env_curve";
-    case rate: return "rate";
-    case start: return "start";
-    case finish: return "finish";
-    case lpf: return "lpf";
-    case lpf_slide: return "lpf_slide";
-    case lpf_slide_shape: return "lpf_slide_shape";
-    case lpf_slide_curve: return "lpf_slide_curve";
-    case lpf_attack: return "lpf_attack";
-    case lpf_sustain: return "lpf_sustain";
-    case lpf_decay: return "lpf_decay";
-    case lpf_release: return "lpf_release";
-    case lpf_min: return "lpf_min";
-    case lpf_min_slide: return "lpf_min_slide";
-    case lpf_min_slide_shape: return "lpf_min_slide_shape";
-    case lpf_min_slide_curve: return "lpf_min_slide_curve";
-    case lpf_init_level: return "lpf_init_level";
-    case lpf_attack_level: return "lpf_attack_level";
-    case lpf_decay_level: return "lpf_decay_level";
-    case lpf_sustain_level: return "lpf_sustain_level";
-    case lpf_release_level: return "lpf_release_level";
-    case lpf_env_curve: return "lpf_env_curve";
-    case hpf: return "hpf";
-    case hpf_slide: return "hpf_slide";
-    case hpf_slide_shape: return "hpf_slide_shape";
-    case hpf_slide_curve: return "hpf_slide_curve";
-    case hpf_max: return "hpf_max";
-    case hpf_max_slide: return "hpf_max_slide";
-    case hpf_max_slide_shape: return "hpf_max_slide_shape";
-    case hpf_max_slide_curve: return "hpf_max_slide_curve";
-    case hpf_attack: return "hpf_attack";
-    case hpf_sustain: return "hpf_sustain";
-    case hpf_decay: return "hpf_decay";
-    case hpf_release: return "hpf_release";
-    case hpf_init_level: return "hpf_init_level";
-    case hpf_attack_level: return "hpf_attack_level";
-    case hpf_decay_level: return "hpf_decay_level";
-    case hpf_sustain_level: return "hpf_sustain_level";
-    case hpf_release_level: return "hpf_release_level";
-    case hpf_env_curve: return "hpf_env_curve";
-    case norm: return "norm";
-    case pitch: return "pitch";
-    case pitch_slide: return "pitch_slide";
-    case pitch_slide_shape: return "pitch_slide_shape";
-    case pitch_slide_curve: return "pitch_slide_curve";
-    case window_size: return "window_size";
-    case window_size_slide: return "window_size_slide";
-    case window_size_slide_shape: return "window_size_slide_shape";
-    case window_size_slide_curve: return "window_size_slide_curve";
-    case pitch_dis: return "pitch_dis";
-    case pitch_dis_slide: return "pitch_dis_slide";
-    case pitch_dis_slide_shape: return "pitch_dis_slide_shape";
-    case pitch_dis_slide_curve: return "pitch_dis_slide_curve";
-    case time_dis: return "time_dis";
-    case time_dis_slide: return "time_dis_slide";
-    case time_dis_slide_shape: return "time_dis_slide_shape";
-    case time_dis_slide_curve: return "time_dis_slide_curve";
-    case compress: return "compress";
-    case pre_amp: return "pre_amp";
-    case pre_amp_slide: return "pre_amp_slide";
-    case pre_amp_slide_shape: return "pre_amp_slide_shape";
-    case pre_amp_slide_curve: return "pre_amp_slide_curve";
-    case threshold: return "threshold";
-    case threshold_slide: return "threshold_slide";
-    case threshold_slide_shape: return "threshold_slide_shape";
-    case threshold_slide_curve: return "threshold_slide_curve";
-    case clamp_time: return "clamp_time";
-    case clamp_time_slide: return "clamp_time_slide";
-    case clamp_time_slide_shape: return "clamp_time_slide_shape";
-    case clamp_time_slide_curve: return "clamp_time_slide_curve";
-    case slope_above: return "slope_above";
-    case slope_above_slide: return "slope_above_slide";
-    case slope_above_slide_shape: return "slope_above_slide_shape";
-    case slope_above_slide_curve: return "slope_above_slide_curve";
-    case slope_below: return "slope_below";
-    case slope_below_slide: return "slope_below_slide";
-    case slope_below_slide_shape: return "slope_below_slide_shape";
-    case slope_below_slide_curve: return "slope_below_slide_curve";
-    case relax_time: return "relax_time";
-    case relax_time_slide: return "relax_time_slide";
-    case relax_time_slide_shape: return "relax_time_slide_shape";
-    case relax_time_slide_curve: return "relax_time_slide_curve";
-    case out_bus: return "out_bus";
-    case _nb_params:
-    default: return nullptr;
+    if (p < 0 || p >= _nb_params) {
+        return nullptr;
     }
+    return params_table.name(p).data();
+}
+
+int sample::find_param(std::string_view name)
+{
+    return params_table.find(name);
 }
\ No newline at end of file
@@ -1,12 +1,12 @@
 #pragma once
 
-#include <string>
-#include <unordered_map>
+#include "soundgen/param_set.hpp"
+#include "soundgen/sound_defs.hpp"
 
-struct sample {
-    int id;
+#include <string_view>
 
-    std::string name;
+struct sample {
+    int id; // index in sound_defs::samples()
 
     enum param {
         amp,
@@ -110,7 +110,12 @@ struct sample {
         _nb_params
     };
 
-    std::unordered_map<param, float> params;
+    param_set<param, _nb_params> params = {};
+
+    sound_ref ref() const { return { sound_kind::sample, id }; }
 
     static const char* param_name(param p);
+
+    // returns -1 if not found
+    static int find_param(std::string_view name);
 };
\ No newline at end of file
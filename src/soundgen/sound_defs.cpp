@@ -0,0 +1,106 @@
+#include "soundgen/sound_defs.hpp"
+
+#include <algorithm>
+
+// one bit per char modulo 64, a cheap superset test before the subsequence match
+static uint64_t char_mask(std::string_view s)
+{
+    uint64_t m = 0;
+    for (unsigned char c : s) {
+        m |= uint64_t(1) << (c % 64);
+    }
+    return m;
+}
+
+static bool contains_all_of(std::string_view s, std::string_view part)
+{
+    size_t ip = 0;
+    for (size_t is = 0; is < s.size() && ip < part.size(); is++) {
+        if (s[is] == part[ip]) {
+            ip++;
+        }
+    }
+    return ip == part.size();
+}
+
+sound_defs::sound_defs(std::vector<std::string> synths, std::vector<std::string> samples,
+                       std::vector<std::string> synthdefs)
+    : _synths(std::move(synths))
+    , _samples(std::move(samples))
+    , _synthdefs(std::move(synthdefs))
+{
+    for (size_t i = _synthdefs.size(); i < _synths.size(); i++) {
+        _synthdefs.push_back("sonic-pi-" + _synths[i]);
+    }
+    by_name.reserve(_synths.size() + _samples.size());
+    for (size_t i = 0; i < _synths.size(); i++) {
+        by_name.emplace(_synths[i], sound_ref { sound_kind::synth, int(i) });
+    }
+    for (size_t i = 0; i < _samples.size(); i++) {
+        by_name.emplace(_samples[i], sound_ref { sound_kind::sample, int(i) });
+    }
+
+    sorted.reserve(by_name.size());
+    for (auto const& n : by_name) {
+        sorted.push_back({ n.second, char_mask(n.first) });
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [this](entry const& a, entry const& b) { return name(a.ref) < name(b.ref); });
+
+    // fnv-1a, names are separated by their terminating 0
+    _version = 0xcbf29ce484222325ull;
+    for (auto const* names : { &_synths, &_samples }) {
+        for (auto const& n : *names) {
+            for (unsigned char c : n) {
+                _version = (_version ^ c) * 0x100000001b3ull;
+            }
+            _version = _version * 0x100000001b3ull;
+        }
+        _version = (_version ^ 0xff) * 0x100000001b3ull;
+    }
+}
+
+std::string const& sound_defs::name(sound_ref ref) const
+{
+    return ref.kind == sound_kind::synth ? _synths[size_t(ref.id)] : _samples[size_t(ref.id)];
+}
+
+std::optional<sound_ref> sound_defs::find(std::string_view name) const
+{
+    auto const it = by_name.find(name);
+    if (it == by_name.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::vector<std::string_view> sound_defs::complete(std::string_view part) const
+{
+    std::vector<std::string_view> res;
+
+    auto const prefix_begin = std::lower_bound(
+        sorted.begin(), sorted.end(), part,
+        [this](entry const& e, std::string_view p) { return std::string_view(name(e.ref)) < p; });
+    auto prefix_end = prefix_begin;
+    for (; prefix_end != sorted.end(); ++prefix_end) {
+        std::string_view const n = name(prefix_end->ref);
+        if (n.compare(0, part.size(), part) != 0) {
+            break;
+        }
+        res.push_back(n);
+    }
+
+    uint64_t const part_chars = char_mask(part);
+    auto const     fuzzy      = [&](entry const& e) {
+        if ((e.chars & part_chars) != part_chars) {
+            return;
+        }
+        std::string_view const n = name(e.ref);
+        if (contains_all_of(n, part)) {
+            res.push_back(n);
+        }
+    };
+    std::for_each(sorted.begin(), prefix_begin, fuzzy);
+    std::for_each(prefix_end, sorted.end(), fuzzy);
+    return res;
+}
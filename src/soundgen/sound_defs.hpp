@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class sound_kind { synth, sample };
+
+struct sound_ref {
+    sound_kind kind;
+    int        id;
+};
+
+// Names of the loaded synths and samples, indexed once for lookups and completion
+class sound_defs {
+    std::vector<std::string> _synths;
+    std::vector<std::string> _samples;
+
+    // synthdef names by synth id, as sent in /s_new
+    std::vector<std::string> _synthdefs;
+
+    // views into the names above, which keep their address when the vectors are moved
+    std::unordered_map<std::string_view, sound_ref> by_name;
+
+    struct entry {
+        sound_ref ref;
+        uint64_t  chars;
+    };
+    std::vector<entry> sorted;
+
+    uint64_t _version = 0;
+
+    public:
+    sound_defs() = default;
+    // synthdefs default to the synth names with the sonic-pi- prefix
+    sound_defs(std::vector<std::string> synths, std::vector<std::string> samples,
+               std::vector<std::string> synthdefs = {});
+    sound_defs(sound_defs&&) = default;
+    sound_defs& operator=(sound_defs&&) = default;
+
+    std::vector<std::string> const& synths() const { return _synths; }
+    std::vector<std::string> const& samples() const { return _samples; }
+
+    std::string const& name(sound_ref ref) const;
+
+    std::string const& synthdef(int synth_id) const { return _synthdefs[size_t(synth_id)]; }
+
+    // hash of the names in id order, sound ids of two defs with the same version match
+    uint64_t version() const { return _version; }
+
+    // synths take precedence over samples with the same name
+    std::optional<sound_ref> find(std::string_view name) const;
+
+    // sorted names containing all chars of part in order, prefix matches first
+    std::vector<std::string_view> complete(std::string_view part) const;
+
+    private:
+    sound_defs(sound_defs const&) = delete;
+    sound_defs& operator=(sound_defs const&) = delete;
+};
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "soundgen/sound_pool.hpp"
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4061)
+#pragma warning(disable : 4242)
+#pragma warning(disable : 4365)
+#pragma warning(disable : 4625)
+#pragma warning(disable : 4626)
+#pragma warning(disable : 5026)
+#pragma warning(disable : 5027)
+#endif
+
+#define OSCPKT_OSTREAM_OUTPUT
+#include "soundgen/sc/oscpkt.hh"
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#include <functional>
+
+static void hash_combine(size_t& h, size_t v)
+{
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+}
+
+template<typename Sound>
+static size_t hash_sound(Sound const& s)
+{
+    size_t h = std::hash<int>()(s.id);
+    for (auto const p : s.params) {
+        hash_combine(h, size_t(p.first));
+        hash_combine(h, std::hash<float>()(p.second));
+    }
+    return h;
+}
+
+static size_t hash_sound(std::variant<synth, sample> const& s)
+{
+    size_t h = s.index();
+    hash_combine(h, std::visit([](auto const& snd) { return hash_sound(snd); }, s));
+    return h;
+}
+
+static bool same_sound(std::variant<synth, sample> const& a, std::variant<synth, sample> const& b)
+{
+    if (a.index() != b.index()) {
+        return false;
+    }
+    return std::visit(
+        [&b](auto const& sa) {
+            auto const& sb = std::get<std::decay_t<decltype(sa)>>(b);
+            return sa.id == sb.id && sa.params == sb.params;
+        },
+        a);
+}
+
+static std::string packet(oscpkt::Message const& msg)
+{
+    oscpkt::PacketWriter pw;
+    pw.addMessage(msg);
+    return std::string(pw.packetData(), pw.packetSize());
+}
+
+std::string encode_play(sound_defs const& defs, std::variant<synth, sample> const& s)
+{
+    oscpkt::Message msg("/s_new");
+    if (auto const* sy = std::get_if<synth>(&s)) {
+        msg.pushStr(defs.synthdef(sy->id)).pushInt32(-1).pushInt32(0).pushInt32(0);
+        for (auto const p : sy->params) {
+            msg.pushInt32(int(p.first)).pushFloat(p.second);
+        }
+        return packet(msg);
+    }
+    auto const& sa = std::get<sample>(s);
+    msg.pushStr("sonic-pi-stereo_player").pushInt32(-1).pushInt32(0).pushInt32(0);
+    msg.pushInt32(0).pushInt32(sa.id); // buffers are allocated with the sample id
+    for (auto const p : sa.params) {
+        msg.pushInt32(int(p.first) + 1) // because 0 is buffer id
+            .pushFloat(p.second);
+    }
+    return packet(msg);
+}
+
+sound_pool::sound_pool(sound_defs const& defs)
+    : _defs(defs)
+{
+}
+
+sound_ptr sound_pool::intern(std::variant<synth, sample> s)
+{
+    size_t const                h = hash_sound(s);
+    std::lock_guard<std::mutex> lk(mtx);
+
+    auto const range = entries.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (auto e = it->second.lock()) {
+            if (same_sound(e->sound, s)) {
+                return e;
+            }
+        }
+    }
+
+    // drop entries no tree references anymore, amortized over the insertions
+    if (entries.size() >= next_purge) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            it = it->second.expired() ? entries.erase(it) : std::next(it);
+        }
+        next_purge = 2 * entries.size() + 64;
+    }
+
+    auto osc = encode_play(_defs, s);
+    auto e   = std::make_shared<sound_entry const>(sound_entry { std::move(s), h, std::move(osc) });
+    entries.emplace(h, e);
+    return e;
+}
+
+size_t sound_pool::size()
+{
+    std::lock_guard<std::mutex> lk(mtx);
+    size_t                      n = 0;
+    for (auto const& e : entries) {
+        n += e.second.expired() ? 0 : 1;
+    }
+    return n;
+}
\ No newline at end of file
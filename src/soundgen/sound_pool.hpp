@@ -0,0 +1,47 @@
+#pragma once
+#include "soundgen/sample.hpp"
+#include "soundgen/sound_defs.hpp"
+#include "soundgen/synth.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
+
+// A sound invocation with its /s_new packet, encoded once
+struct sound_entry {
+    std::variant<synth, sample> sound;
+    size_t                      hash;
+    std::string                 osc;
+};
+
+using sound_ptr = std::shared_ptr<sound_entry const>;
+
+// encoded /s_new packet, the node id is left to the server (-1)
+std::string encode_play(sound_defs const& defs, std::variant<synth, sample> const& s);
+
+// Hash-consing of sound invocations: structurally identical sounds share one immutable entry,
+// across every tree parsed with the same pool. Entries live as long as a tree references them.
+class sound_pool {
+    sound_defs const& _defs;
+
+    std::mutex                                                        mtx;
+    std::unordered_multimap<size_t, std::weak_ptr<sound_entry const>> entries;
+    size_t                                                            next_purge = 64;
+
+    public:
+    sound_pool(sound_defs const& defs);
+
+    sound_defs const& defs() const { return _defs; }
+
+    // thread safe
+    sound_ptr intern(std::variant<synth, sample> s);
+
+    // number of live entries
+    size_t size();
+
+    private:
+    sound_pool(sound_pool const&) = delete;
+    sound_pool& operator=(sound_pool const&) = delete;
+};
\ No newline at end of file
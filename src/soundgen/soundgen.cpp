@@ -1,5 +1,6 @@
 #include "soundgen/soundgen.hpp"
 #define WIN32_LEAN_AND_MEAN
+#ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable : 4061)
 #pragma warning(disable : 4242)
@@ -16,12 +17,15 @@
 #pragma warning(disable : 5031)
 #pragma warning(disable : 5039)
 #pragma warning(disable : 5204)
+#endif
 
 #define OSCPKT_OSTREAM_OUTPUT
 #include "soundgen/sc/oscpkt.hh"
 
 #include <boost/asio.hpp>
+#ifdef _MSC_VER
 #pragma warning(pop)
+#endif
 
 #include <array>
 #include <filesystem>
@@ -41,8 +45,13 @@ struct soundgen::pimpl {
     baendpoint             server_addr;
     std::array<char, 1024> recv_buffer;
     bool                   debug = true;
-    pimpl()
+    bool const             offline;
+
+    std::vector<std::string> loads;
+
+    pimpl(bool offline)
         : sock(ioc)
+        , offline(offline)
     {
     }
 
@@ -57,12 +66,29 @@ struct soundgen::pimpl {
 
     bool send(Message const& msg)
     {
+        if (offline) {
+            return false;
+        }
         oscpkt::PacketWriter pw;
         pw.addMessage(msg);
         std::cout << "Msg:" << msg << std::endl;
         return sock.send_to(ba::buffer(pw.packetData(), pw.packetSize()), server_addr) > 0;
     }
 
+    bool send(std::string const& packet)
+    {
+        if (offline) {
+            return false;
+        }
+        if (debug) {
+            oscpkt::PacketReader pr(packet.data(), packet.size());
+            if (auto const* msg = pr.popMessage()) {
+                std::cout << "Msg:" << *msg << std::endl;
+            }
+        }
+        return sock.send_to(ba::buffer(packet), server_addr) > 0;
+    }
+
     void wait_for_response()
     {
         auto const           recvlen = sock.receive(ba::buffer(recv_buffer));
@@ -80,7 +106,7 @@ struct soundgen::pimpl {
     }
     void consume_responses()
     {
-        while (sock.available() > 0) {
+        while (!offline && sock.available() > 0) {
             sock.receive(ba::buffer(recv_buffer));
         }
     }
@@ -100,77 +126,84 @@ struct soundgen::pimpl {
     {
         send(Message("/d_load").pushStr(path.generic_string()));
         consume_responses();
+        keep(Message("/d_load").pushStr(fs::absolute(path).generic_string()));
     }
     void load_sound(fs::path const& path, int id)
     {
         send(Message("/b_allocRead").pushInt32(id).pushStr(path.generic_string()));
         consume_responses();
+        keep(Message("/b_allocRead").pushInt32(id).pushStr(fs::absolute(path).generic_string()));
+    }
+    // for load_packets
+    void keep(Message const& msg)
+    {
+        oscpkt::PacketWriter pw;
+        pw.addMessage(msg);
+        loads.emplace_back(pw.packetData(), pw.packetSize());
     }
 };
 
-soundgen::soundgen()
-    : _p(std::make_unique<pimpl>())
+soundgen::soundgen(bool offline)
+    : _p(std::make_unique<pimpl>(offline))
 {
-    _p->connect("127.0.0.1", 1988);
-
-    _p->init();
+    if (!offline) {
+        _p->connect("127.0.0.1", 1988);
+        _p->init();
+    }
 
     _p->load_synth("etc/synthdefs/utils/sonic-pi-stereo_player.scsyndef");
 
+    std::vector<std::string> synths;
+    std::vector<std::string> synthdefs;
+    std::vector<std::string> samples;
+
     std::cout << "synth: " << std::endl;
     for (auto it = fs::directory_iterator("etc/synthdefs/synth"); it != fs::directory_iterator();
          ++it) {
         std::cout << it->path() << std::endl;
         _p->load_synth(it->path());
         auto filename = it->path().filename().stem().string();
-        filename      = filename.substr(9); // todo, better handling of prefixes
-        defs.synths.push_back(filename);
+        synths.push_back(filename.substr(9)); // todo, better handling of prefixes
+        synthdefs.push_back(std::move(filename));
     }
 
     std::cout << "sounds: " << std::endl;
     for (auto it = fs::directory_iterator("etc/samples"); it != fs::directory_iterator(); ++it) {
         std::cout << it->path() << std::endl;
-        _p->load_sound(it->path(), (int)defs.samples.size());
-        defs.samples.push_back(it->path().filename().stem().string());
+        _p->load_sound(it->path(), (int)samples.size());
+        samples.push_back(it->path().filename().stem().string());
     }
+
+    defs = sound_defs(std::move(synths), std::move(samples), std::move(synthdefs));
 }
 
 soundgen::~soundgen()
 {
 }
 
-static int cpt = 1;
-
 void soundgen::play(synth const& s)
 {
-    Message msg("/s_new");
-    // todo, better handling of prefixes
-    msg.pushStr("sonic-pi-" + s.name).pushInt32(cpt++).pushInt32(0).pushInt32(0);
-    for (auto& p : s.params) {
-        msg.pushInt32(int(p.first)).pushFloat(p.second);
-    }
-    _p->send(msg);
+    _p->send(encode_play(defs, s));
 }
 
 void soundgen::play(sample const& s)
 {
-    int id = -1;
-    for (size_t i = 0; i < defs.samples.size(); i++) {
-        if (defs.samples[i] == s.name) {
-            id = (int)i;
-            break;
-        }
-    }
-    if (id < 0) {
-        std::cerr << "sample not found: " << s.name << std::endl;
-        return;
-    }
-    Message msg("/s_new");
-    msg.pushStr("sonic-pi-stereo_player").pushInt32(cpt++).pushInt32(0).pushInt32(0);
-    msg.pushInt32(0).pushInt32(id);
-    for (auto& p : s.params) {
-        msg.pushInt32(int(p.first) + 1) // because 0 is buffer id
-            .pushFloat(p.second);
+    _p->send(encode_play(defs, s));
+}
+
+void soundgen::play(sound_entry const& s)
+{
+    _p->send(s.osc);
+}
+
+void soundgen::send(std::string const& packet)
+{
+    if (!_p->offline) {
+        _p->sock.send_to(ba::buffer(packet), _p->server_addr);
     }
-    _p->send(msg);
+}
+
+std::vector<std::string> const& soundgen::load_packets() const
+{
+    return _p->loads;
 }
\ No newline at end of file
@@ -1,20 +1,22 @@
 #pragma once
 #include "soundgen/sample.hpp"
+#include "soundgen/sound_defs.hpp"
+#include "soundgen/sound_pool.hpp"
 #include "soundgen/synth.hpp"
 
 #include <memory>
 #include <string>
-
-struct sound_defs {
-    std::vector<std::string> synths;
-    std::vector<std::string> samples;
-};
+#include <vector>
 
 class soundgen {
     public:
     sound_defs defs;
 
-    soundgen();
+    // sounds of all the parsed mixes
+    sound_pool pool { defs };
+
+    // offline, the sounds are listed but there is no server, nothing is sent
+    explicit soundgen(bool offline = false);
 
     ~soundgen();
 
@@ -22,6 +24,15 @@ class soundgen {
 
     void play(sample const& s);
 
+    // sends the precomputed packet
+    void play(sound_entry const& s);
+
+    // sends an encoded packet as is, without the debug print
+    void send(std::string const& packet);
+
+    // /d_load and /b_allocRead packets of the loaded sounds, with absolute paths
+    std::vector<std::string> const& load_packets() const;
+
     private:
     struct pimpl;
     std::unique_ptr<pimpl> _p;
@@ -11,18 +11,6 @@
 #include <array>
 #include <set>
 
-bool contains_all_of(std::string const& s, std::string const& part)
-{
-    size_t ip = 0;
-    size_t is = 0;
-    for (; is < s.size() && ip < part.size(); is++) {
-        if (s[is] == part[ip]) {
-            ip++;
-        }
-    }
-    return (ip == part.size());
-}
-
 struct codeedit::pimpl {
     app&              ap;
     std::string const mixname;
@@ -42,6 +30,7 @@ struct codeedit::pimpl {
         0xff0000ff, // error
     };
     std::vector<ImU32> colors;
+    int                colors_version = -1;
 
     pimpl(app& ap, std::string const& mn, app::mix& m)
         : ap(ap)
@@ -51,17 +40,14 @@ struct codeedit::pimpl {
         update_colors();
     }
 
-    void parse()
-    {
-        ap.parse(mx);
-        update_colors();
-    }
+    void parse() { ap.parse_async(mx); }
     void update_colors()
     {
         auto const& ct = mx.pars.char_types;
         colors.resize(ct.size());
         std::transform(ct.begin(), ct.end(), colors.begin(),
                        [this](char_type t) { return palette[size_t(t)]; });
+        colors_version = mx.parsed_version;
     }
 
     static int InputTextCallback(ImGuiInputTextCallbackData* data)
@@ -90,8 +76,26 @@ struct codeedit::pimpl {
             filename = mx.pars.filename;
             update_colors();
         }
+        if (colors_version != mx.parsed_version) {
+            update_colors();
+        }
         auto const& buffer = mx.pars.buffer;
+        // highlighting may lag behind the buffer while the worker is parsing
+        if (colors.size() <= buffer.capacity()) {
+            colors.resize(buffer.capacity() + 1, palette[size_t(char_type::none)]);
+        }
         ImGui::Text("%s %s", filename.c_str(), mx.saved ? "" : "*");
+        if (!mx.save_error.empty()) {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(1, 0, 0, 1), "%s", mx.save_error.c_str());
+        }
+        if (auto const played = ap.ch.mixes.find(mx.name); played != ap.ch.mixes.end()) {
+            for (auto const& name : played->second.unresolved) {
+                ImGui::SameLine();
+                ImGui::TextColored(ImVec4(1, 1, 0, 1), "pattern '%s' is not defined",
+                                   name.c_str());
+            }
+        }
         if (CodeEditor(filename.c_str(), (char*)buffer.c_str(), (int)buffer.capacity() + 1,
                        colors.empty() ? nullptr : colors.data(), ImVec2(-FLT_MIN, -1), 0,
                        InputTextCallback, this)) {
@@ -120,9 +124,12 @@ struct codeedit::pimpl {
     }
     bool format_buffer(ImGuiInputTextCallbackData* data)
     {
+        if (!mx.pars.error.empty() || mx.parsed_version != mx.version) {
+            return false;
+        }
         std::string formated;
         formated.reserve(mx.pars.buffer.size());
-        ::print(mx.pars.tree, formated);
+        ::print(*mx.pars.tree, ap.sg.defs, formated);
         if (formated == mx.pars.buffer) {
             return false;
         }
@@ -158,8 +165,6 @@ struct codeedit::pimpl {
     }
     bool update_completion(ImGuiInputTextCallbackData* data)
     {
-        std::vector<std::string> completions;
-
         auto databgn = data->Buf;
         auto datacur = data->Buf + data->CursorPos;
         auto dataend = data->Buf + data->BufTextLen;
@@ -180,39 +185,22 @@ struct codeedit::pimpl {
         }
 
         tokb = datacur - 1;
-        if (*tokb == '\'') {
-            for (auto& s : ap.sg.defs.samples) {
-                completions.push_back(s);
-            }
-            for (auto& s : ap.sg.defs.synths) {
-                completions.push_back(s);
-            }
-            std::sort(completions.begin(), completions.end());
+        while (*tokb != '\'') {
+            if (*tokb == '\n')
+                return false;
+            if (*tokb == ' ')
+                return false;
+            tokb--;
+            if (tokb == databgn)
+                return false;
         }
-        else {
-            while (*tokb != '\'') {
-                if (*tokb == '\n')
-                    return false;
-                if (*tokb == ' ')
-                    return false;
-                tokb--;
-                if (tokb == databgn)
-                    return false;
-            }
-            std::string const part(tokb + 1, datacur);
+        std::string_view const part(tokb + 1, size_t(datacur - tokb - 1));
+
+        auto const completions = ap.sg.defs.complete(part);
 
-            for (auto& s : ap.sg.defs.samples) {
-                if (contains_all_of(s, part))
-                    completions.push_back(s);
-            }
-            for (auto& s : ap.sg.defs.synths) {
-                if (contains_all_of(s, part))
-                    completions.push_back(s);
-            }
-        }
         completion.clear();
         if (!completions.empty()) {
-            completion       = *completions.begin() + '\'';
+            completion       = std::string(completions.front()) + '\'';
             completionoffset = int(datacur - tokb - 1);
             auto toke        = datacur;
             completiononset  = 0;
@@ -223,7 +211,7 @@ struct codeedit::pimpl {
         }
         completionsdata.clear();
         for (auto& c : completions) {
-            completionsdata += c + "\n";
+            completionsdata.append(c).append("\n");
         }
         data->Buf        = (char*)completionsdata.c_str();
         data->BufTextLen = (int)completionsdata.size();
@@ -246,11 +234,12 @@ codeedit::~codeedit()
 
 void codeedit::draw()
 {
-    assert(!editors.empty());
-    if (editors.size() != ap.mixes.size()
-        || editors[0]->filename != ap.mixes.begin()->second.pars.filename) {
+    if (files_version != ap.files_version) {
         reset_editors();
     }
+    if (editors.empty()) {
+        return;
+    }
 
     auto const   colsdiv = div((int)editors.size(), 2);
     auto const   cols1   = (size_t)ceil(editors.size() / 2.0);
@@ -280,6 +269,7 @@ void codeedit::draw()
 void codeedit::reset_editors()
 {
     editors.clear();
+    files_version = ap.files_version;
     for (auto& mix : ap.mixes) {
         editors.emplace_back(std::make_unique<pimpl>(ap, mix.first, mix.second));
     }
@@ -19,6 +19,7 @@ class codeedit {
     void reset_editors();
     struct pimpl;
     std::vector<std::unique_ptr<pimpl>> editors;
+    int                                 files_version = -1; // of the app mixes the editors show
     codeedit(codeedit const&) = delete;
     codeedit operator=(codeedit const&) = delete;
 };
\ No newline at end of file
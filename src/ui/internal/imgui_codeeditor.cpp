@@ -1,5 +1,7 @@
 #include "ui/internal/imgui_codeeditor.h"
+#ifdef _MSC_VER
 #pragma warning(disable : 4505)
+#endif
 #ifndef IMGUI_DEFINE_MATH_OPERATORS
 #define IMGUI_DEFINE_MATH_OPERATORS
 #endif
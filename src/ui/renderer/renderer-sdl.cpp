@@ -0,0 +1,140 @@
+#include "ui/renderer/renderer.hpp"
+
+#include "imgui.h"
+#include "imgui_impl_opengl2.h"
+#include "imgui_impl_sdl.h"
+
+#include <SDL.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <tuple>
+
+// SDL2 window drawn with the OpenGL 2 fixed pipeline, which Mesa software rendering runs.
+// Frames are only drawn after input, when app results or the playhead change, and at a
+// capped rate while playing. Between frames the loop sleeps in SDL_WaitEventTimeout.
+
+namespace {
+
+SDL_Window*   window  = nullptr;
+SDL_GLContext context = nullptr;
+
+// after an event, ImGui needs a few frames to settle hover, focus and popups
+int const settle_frames = 3;
+
+// redraws per second while playing, for the sub beat counter
+int const playing_fps = 30;
+
+// what the ui shows of the app, a frame is drawn when it changes
+auto shown_state(app const& a)
+{
+    return std::make_tuple(a.files_version, a.state_version, a.is_running, a.ch.measure,
+                           a.ch.beat);
+}
+
+} // namespace
+
+renderer::renderer(app& a, render_options const& options)
+{
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
+        throw std::runtime_error(std::string("cannot init SDL: ") + SDL_GetError());
+    }
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    auto const flags = SDL_WindowFlags(SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE
+                                       | SDL_WINDOW_ALLOW_HIGHDPI
+                                       | (options.maximized ? SDL_WINDOW_MAXIMIZED : 0));
+    window = SDL_CreateWindow(options.title.c_str(), options.x, options.y, options.w, options.h,
+                              flags);
+    if (!window) {
+        throw std::runtime_error(std::string("cannot create window: ") + SDL_GetError());
+    }
+    context = SDL_GL_CreateContext(window);
+    if (!context) {
+        throw std::runtime_error(std::string("cannot create OpenGL context: ") + SDL_GetError());
+    }
+    SDL_GL_MakeCurrent(window, context);
+    // no vsync, a swap must not hold the scheduler for a whole refresh
+    SDL_GL_SetSwapInterval(0);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+
+    target = std::make_unique<ui>(a);
+
+    ImGui_ImplSDL2_InitForOpenGL(window, context);
+    ImGui_ImplOpenGL2_Init();
+}
+
+void renderer::run()
+{
+    using clock = std::chrono::steady_clock;
+
+    app&              ap      = target->ap;
+    int               pending = settle_frames;
+    auto              shown   = shown_state(ap);
+    clock::time_point next_playing_frame;
+
+    for (;;) {
+        // the wait is also the scheduler tick, app::update runs every millisecond
+        SDL_Event ev;
+        for (bool got = SDL_WaitEventTimeout(&ev, 1) != 0; got; got = SDL_PollEvent(&ev) != 0) {
+            ImGui_ImplSDL2_ProcessEvent(&ev);
+            if (ev.type == SDL_QUIT) {
+                return;
+            }
+            pending = settle_frames;
+        }
+
+        ap.update();
+
+        auto const state = shown_state(ap);
+        if (state != shown) {
+            shown   = state;
+            pending = std::max(pending, 1);
+        }
+        auto const now = clock::now();
+        if (ap.is_running && now >= next_playing_frame) {
+            next_playing_frame = now + std::chrono::microseconds(1000000 / playing_fps);
+            pending            = std::max(pending, 1);
+        }
+        if (pending == 0) {
+            continue;
+        }
+        pending--;
+
+        ImGui_ImplOpenGL2_NewFrame();
+        ImGui_ImplSDL2_NewFrame(window);
+        ImGui::NewFrame();
+
+        int w = 0;
+        int h = 0;
+        SDL_GetWindowSize(window, &w, &h);
+        if (!target->frame(w, h)) {
+            return;
+        }
+
+        ImGui::Render();
+        int dw = 0;
+        int dh = 0;
+        SDL_GL_GetDrawableSize(window, &dw, &dh);
+        glViewport(0, 0, dw, dh);
+        auto const& c = target->clear_color;
+        glClearColor(c.x, c.y, c.z, c.w);
+        glClear(GL_COLOR_BUFFER_BIT);
+        ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+        SDL_GL_SwapWindow(window);
+    }
+}
+
+renderer::~renderer()
+{
+    target.reset();
+    ImGui_ImplOpenGL2_Shutdown();
+    ImGui_ImplSDL2_Shutdown();
+    ImGui::DestroyContext();
+
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+}
\ No newline at end of file
@@ -18,7 +18,16 @@ ui::ui(app& a)
 {
     ImGui::StyleColorsDark();
     ImGuiIO& io = ImGui::GetIO();
-    io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\FiraCode-Regular.ttf", 20.0f);
+    // the default font is used when none is installed
+    for (char const* font : { "c:\\Windows\\Fonts\\FiraCode-Regular.ttf",
+                              "/usr/share/fonts/truetype/firacode/FiraCode-Regular.ttf",
+                              "/usr/share/fonts/TTF/FiraCode-Regular.ttf" }) {
+        std::error_code ec;
+        if (fs::is_regular_file(font, ec)) {
+            io.Fonts->AddFontFromFileTTF(font, 20.0f);
+            break;
+        }
+    }
 }
 
 ui::~ui()
@@ -27,8 +36,6 @@ ui::~ui()
 
 bool ui::frame(int width, int height)
 {
-    ap.update();
-
     handle_shortcuts();
 
     if (!draw_menu()) {
@@ -60,10 +67,10 @@ bool ui::frame(int width, int height)
 
     if (ImGui::CollapsingHeader("Synth")) {
         int i = 0;
-        for (auto& s : ap.sg.defs.synths) {
+        for (auto& s : ap.sg.defs.synths()) {
             ImGui::PushID(i);
             if (ImGui::Button(">")) {
-                ap.sg.play(synth { i, s, { { synth::note, 60.f } } });
+                ap.sg.play(synth { i, { { synth::note, 60.f } } });
             }
             ImGui::PopID();
             ImGui::SameLine();
@@ -74,10 +81,10 @@ bool ui::frame(int width, int height)
 
     if (ImGui::CollapsingHeader("Samples")) {
         int i = 0;
-        for (auto& s : ap.sg.defs.samples) {
+        for (auto& s : ap.sg.defs.samples()) {
             ImGui::PushID(i);
             if (ImGui::Button(">")) {
-                ap.sg.play(sample { i, s });
+                ap.sg.play(sample { i });
             }
             ImGui::PopID();
             ImGui::SameLine();
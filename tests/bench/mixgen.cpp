@@ -0,0 +1,86 @@
+#include "bench/mixgen.hpp"
+
+#include <array>
+
+namespace {
+
+std::array<char const*, 6> const drums = {
+    "drum_bass_hard",   "drum_bass_soft",    "drum_cymbal_closed",
+    "drum_cymbal_soft", "drum_cymbal_pedal", "drum_snare_hard",
+};
+
+std::array<char const*, 3> const synths = { "piano", "tb303", "beep" };
+
+std::array<char const*, 8> const synth_params = {
+    "amp", "pan", "attack", "release", "cutoff", "res", "sustain", "env_curve",
+};
+
+// small linear congruential generator, std distributions differ between libraries
+struct rng {
+    unsigned state = 12345;
+    int      operator()(int n)
+    {
+        state = state * 1103515245u + 12345u;
+        return int((state >> 16) % unsigned(n));
+    }
+};
+
+} // namespace
+
+sound_defs const& bench_sounds()
+{
+    static sound_defs const sounds({ synths.begin(), synths.end() },
+                                   { drums.begin(), drums.end() });
+    return sounds;
+}
+
+std::string gen_drum_mix(int nb_lines)
+{
+    rng         r;
+    std::string s;
+    for (int i = 0; i < nb_lines; i++) {
+        if (i % 16 == 0) {
+            s += " ~ block " + std::to_string(i / 16) + "\nseq 2\n";
+        }
+        s += "  on " + std::to_string(1 + (i % 16) / 2);
+        if (i % 2) {
+            s += " " + std::to_string(1 + r(4)) + "/4";
+        }
+        s += std::string(" '") + drums[size_t(r(int(drums.size())))] + "'\n";
+    }
+    return s;
+}
+
+std::string gen_nested_mix(int nb_measures)
+{
+    rng         r;
+    std::string s;
+    for (int m = 1; m <= nb_measures; m += 4) {
+        s += std::to_string(m) + "-" + std::to_string(m + 3) + ":\n";
+        s += "  tempo " + std::to_string(80 + r(60)) + "\n";
+        s += "  seq 4\n";
+        for (int b = 1; b <= 16; b++) {
+            s += "    on " + std::to_string(b) + "\n";
+            for (int n = 0; n < 3; n++) {
+                s += std::string("      '") + synths[size_t(r(int(synths.size())))] + "' ( note:"
+                    + std::to_string(40 + r(30)) + " )\n";
+            }
+        }
+    }
+    return s;
+}
+
+std::string gen_param_mix(int nb_lines)
+{
+    rng         r;
+    std::string s = "seq 8\n";
+    for (int i = 0; i < nb_lines; i++) {
+        s += "  on " + std::to_string(1 + i % 32) + " '" + synths[size_t(r(int(synths.size())))]
+            + "' ( note:" + std::to_string(40 + r(30));
+        for (auto p : synth_params) {
+            s += std::string(" ") + p + ":0." + std::to_string(r(100));
+        }
+        s += " )\n";
+    }
+    return s;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "soundgen/sound_defs.hpp"
+
+#include <string>
+
+// Generators of large but realistic mixes for the benchmarks, deterministic for a given size
+
+// the synths and samples used by the generated mixes
+sound_defs const& bench_sounds();
+
+// seq blocks of 8 beats with sub beats, one drum sample per line
+std::string gen_drum_mix(int nb_lines);
+
+// measure ranges holding sequences of beats playing several sounds each
+std::string gen_nested_mix(int nb_measures);
+
+// synth lines with many params each
+std::string gen_param_mix(int nb_lines);
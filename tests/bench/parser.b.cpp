@@ -0,0 +1,102 @@
+#include "bench/mixgen.hpp"
+#include "catch2/catch.hpp"
+#include "parser/lexer.hpp"
+#include "parser/lexertk.hpp"
+#include "parser/parse_cache.hpp"
+#include "parser/parser.hpp"
+
+namespace {
+
+struct bench_mix {
+    char const* name;
+    std::string buffer;
+};
+
+std::vector<bench_mix> const& bench_mixes()
+{
+    static std::vector<bench_mix> const mixes = {
+        { "drums 10k lines", gen_drum_mix(10000) },
+        { "nested 400 measures", gen_nested_mix(400) },
+        { "params 5k lines", gen_param_mix(5000) },
+    };
+    return mixes;
+}
+
+} // namespace
+
+TEST_CASE("Generated mixes parse")
+{
+    for (auto const& m : bench_mixes()) {
+        parser prs(bench_sounds());
+        prs.buffer = m.buffer;
+        INFO(m.name);
+        REQUIRE(prs.parse());
+        REQUIRE(!prs.tree->empty());
+    }
+}
+
+TEST_CASE("Lexing", "[.][benchmark]")
+{
+    for (auto const& m : bench_mixes()) {
+        BENCHMARK(std::string("lexer ") + m.name)
+        {
+            lexer l;
+            l.process(m.buffer);
+            return l.size();
+        };
+        BENCHMARK(std::string("lexertk ") + m.name)
+        {
+            lexertk::generator g;
+            g.process(m.buffer);
+            return g.size();
+        };
+    }
+}
+
+TEST_CASE("Parsing", "[.][benchmark]")
+{
+    for (auto const& m : bench_mixes()) {
+        parser prs(bench_sounds());
+        prs.buffer = m.buffer;
+        BENCHMARK(std::string("parse ") + m.name) { return prs.parse(); };
+        BENCHMARK(std::string("highlight ") + m.name)
+        {
+            prs.highlight();
+            return prs.char_types.size();
+        };
+    }
+}
+
+TEST_CASE("Cached parsing", "[.][benchmark]")
+{
+    auto const  folder = std::filesystem::temp_directory_path() / "dacapo-bench-cache";
+    sound_pool  pool(bench_sounds());
+    parse_cache cache(pool, folder);
+    for (auto const& m : bench_mixes()) {
+        parser prs(pool);
+        prs.buffer = m.buffer;
+        prs.parse();
+        cache.store(prs);
+        BENCHMARK(std::string("load cached ") + m.name)
+        {
+            return parse_cache(pool, folder).load(prs);
+        };
+        BENCHMARK(std::string("load recent ") + m.name) { return cache.load(prs); };
+    }
+    std::filesystem::remove_all(folder);
+}
+
+TEST_CASE("Formatting", "[.][benchmark]")
+{
+    for (auto const& m : bench_mixes()) {
+        parser prs(bench_sounds());
+        prs.buffer = m.buffer;
+        prs.parse();
+        std::string formatted;
+        BENCHMARK(std::string("print ") + m.name)
+        {
+            print(*prs.tree, bench_sounds(), formatted);
+            return formatted.size();
+        };
+    }
+}
@@ -0,0 +1,28 @@
+# cmake -DBENCH_EXE=... -DSOURCE_DIR=... -DOUTPUT_DIR=... -P run_bench.cmake
+execute_process(
+  COMMAND git rev-parse --short HEAD
+  WORKING_DIRECTORY ${SOURCE_DIR}
+  OUTPUT_VARIABLE COMMIT
+  OUTPUT_STRIP_TRAILING_WHITESPACE
+)
+execute_process(
+  COMMAND git diff --quiet HEAD
+  WORKING_DIRECTORY ${SOURCE_DIR}
+  RESULT_VARIABLE DIRTY
+)
+if(NOT COMMIT)
+  set(COMMIT unknown)
+endif()
+if(DIRTY)
+  set(COMMIT ${COMMIT}-dirty)
+endif()
+
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+message("Benchmark results: ${OUTPUT_DIR}/${COMMIT}.xml")
+execute_process(
+  COMMAND ${BENCH_EXE} [benchmark] --reporter xml --out ${OUTPUT_DIR}/${COMMIT}.xml
+  RESULT_VARIABLE RES
+)
+if(RES)
+  message(FATAL_ERROR "dacapobench failed")
+endif()
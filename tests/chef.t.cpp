@@ -0,0 +1,194 @@
+#include "catch2/catch.hpp"
+#include "chef/chef.hpp"
+#include "parser/parser.hpp"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+// mixes played by a chef on its virtual clock, with the sounds it gives to its output
+struct schedule {
+    sound_pool&              pool;
+    chef                     ch;
+    mix_trees                trees;
+    std::vector<std::string> played; // "measure.beat.sub_beat name", and the note of synths
+
+    schedule(sound_pool& pool)
+        : pool(pool)
+        , ch(pool)
+    {
+        ch.trace              = false;
+        ch.sub_beats_per_beat = 4;
+        ch.output             = [this](std::string const&, sound_entry const& s) {
+            auto e = std::to_string(ch.measure) + "." + std::to_string(ch.beat) + "."
+                     + std::to_string(ch.sub_beat) + " ";
+            std::visit([&](auto const& snd) { e += this->pool.defs().name(snd.ref()); }, s.sound);
+            if (auto const* sy = std::get_if<synth>(&s.sound)) {
+                if (sy->params.contains(synth::note)) {
+                    e += " " + std::to_string(std::lround(sy->params.at(synth::note)));
+                }
+            }
+            played.push_back(e);
+        };
+    }
+
+    // parses buffer as the mix name, the mixes set before can be imported
+    void set(std::string const& name, std::string const& buffer)
+    {
+        parser prs(pool);
+        prs.filename = name + ".dcp";
+        prs.mixes    = trees;
+        prs.buffer   = buffer;
+        REQUIRE(prs.parse());
+        trees[name] = prs.tree;
+        ch.set_mix(name, prs.tree);
+    }
+
+    // sounds played during the next measures
+    std::vector<std::string> run(int measures)
+    {
+        played.clear();
+        for (int i = 0; i < measures * ch.beats_per_measure * ch.sub_beats_per_beat; i++) {
+            ch.step();
+        }
+        return played;
+    }
+
+    private:
+    schedule(schedule const&) = delete;
+    schedule& operator=(schedule const&) = delete;
+};
+
+using sounds = std::vector<std::string>;
+
+} // namespace
+
+TEST_CASE("Chef")
+{
+    sound_defs const defs { { "beep" }, { "drum_bass_hard", "drum_snare_hard" } };
+    sound_pool       pool(defs);
+    schedule         s(pool);
+
+    SECTION("Patterns")
+    {
+        s.set("lib", "def groove:\n"
+                     "  on 1 'drum_bass_hard'\n"
+                     "  on 3 'beep' ( note:60 )\n");
+        REQUIRE(s.run(1).empty());
+
+        // transpose shifts synth notes, offset delays the pattern in beats
+        s.set("song", "use groove\n"
+                      "2: use groove ( transpose:-12 offset:1 )\n");
+        REQUIRE(s.run(2)
+                == sounds { "2.1.1 drum_bass_hard", "2.2.1 drum_bass_hard", "2.3.1 beep 60",
+                            "2.4.1 beep 48", "3.1.1 drum_bass_hard", "3.3.1 beep 60" });
+
+        // an offset past the measure wraps around it
+        s.set("song", "use groove ( offset:3 )\n");
+        REQUIRE(s.run(1) == sounds { "4.2.1 beep 60", "4.4.1 drum_bass_hard" });
+
+        // every use plays the edited def
+        s.set("song", "use groove\n");
+        s.set("lib", "def groove:\n"
+                     "  on 2 'drum_snare_hard'\n");
+        REQUIRE(s.run(1) == sounds { "5.2.1 drum_snare_hard" });
+
+        // in a sequence the pattern beats count over its measures, as its statements would
+        s.set("song", "seq 2\n"
+                      "  use groove\n"
+                      "  use groove ( offset:5 )\n");
+        REQUIRE(s.run(2) == sounds { "6.2.1 drum_snare_hard", "7.3.1 drum_snare_hard" });
+    }
+    SECTION("Pattern resolution")
+    {
+        s.set("a", "def groove:\n  on 1 'drum_bass_hard'\n");
+        s.set("b", "def groove:\n  on 1 'drum_snare_hard'\n");
+        // an import comes before the first mix by name, the mix itself before both
+        s.set("c", "import 'b'\nuse groove\n");
+        REQUIRE(s.run(1) == sounds { "1.1.1 drum_snare_hard" });
+        s.set("c", "use groove\n");
+        REQUIRE(s.run(1) == sounds { "2.1.1 drum_bass_hard" });
+        s.set("c", "import 'b'\ndef groove:\n  on 2 'beep'\nuse groove\n");
+        REQUIRE(s.run(1) == sounds { "3.2.1 beep" });
+
+        // an undefined pattern plays nothing and is reported
+        s.set("c", "use fill\n");
+        REQUIRE(s.run(1).empty());
+        REQUIRE(s.ch.mixes.at("c").unresolved == std::vector<std::string> { "fill" });
+        s.set("a", "def fill:\n  on 4 'beep'\n");
+        REQUIRE(s.run(1) == sounds { "5.4.1 beep" });
+        REQUIRE(s.ch.mixes.at("c").unresolved.empty());
+    }
+    SECTION("Loops")
+    {
+        // repeat splits the measure in equal parts, its body beats count in one part
+        s.set("loop", "repeat 2\n"
+                      "  on 1 'drum_bass_hard'\n"
+                      "  on 2 'beep'\n");
+        REQUIRE(s.run(1)
+                == sounds { "1.1.1 drum_bass_hard", "1.2.1 beep", "1.3.1 drum_bass_hard",
+                            "1.4.1 beep" });
+        s.set("loop", "repeat 4 on 1 2/2 'beep'\n");
+        REQUIRE(s.run(1) == sounds { "2.1.3 beep", "2.2.3 beep", "2.3.3 beep", "2.4.3 beep" });
+
+        // the parts left over by an uneven split are silent, as are parts shorter than a beat
+        s.set("loop", "repeat 3 on 1 'beep'\n");
+        REQUIRE(s.run(1) == sounds { "3.1.1 beep", "3.2.1 beep", "3.3.1 beep" });
+        s.set("loop", "repeat 8 on 1 'beep'\n");
+        REQUIRE(s.run(1).empty());
+
+        // every counts the measures at the top level, the parts in a repeat
+        s.ch.rewind();
+        s.set("loop", "every 2 on 1 'drum_snare_hard'\n");
+        REQUIRE(s.run(4) == sounds { "1.1.1 drum_snare_hard", "3.1.1 drum_snare_hard" });
+        s.set("loop", "repeat 4 every 2 on 1 'beep'\n");
+        REQUIRE(s.run(1) == sounds { "5.1.1 beep", "5.3.1 beep" });
+
+        // and the loops of a sequence
+        s.ch.rewind();
+        s.set("loop", "seq 2\n"
+                      "  every 2 on 1 'beep'\n"
+                      "  on 6 'drum_bass_hard'\n");
+        REQUIRE(s.run(6)
+                == sounds { "1.1.1 beep", "2.2.1 drum_bass_hard", "4.2.1 drum_bass_hard",
+                            "5.1.1 beep", "6.2.1 drum_bass_hard" });
+    }
+    SECTION("Sequence phase")
+    {
+        std::string const seq = "seq 3\n"
+                                "  on 1 'beep'\n"
+                                "  on 5 'drum_bass_hard'\n"
+                                "  every 2 on 6 'beep'\n"
+                                "  on 9 'drum_snare_hard'\n";
+        s.set("phase", seq);
+        REQUIRE(s.run(4)
+                == sounds { "1.1.1 beep", "2.1.1 drum_bass_hard", "2.2.1 beep",
+                            "3.1.1 drum_snare_hard", "4.1.1 beep" });
+
+        // a reparse inserting a line before the sequence keeps its start measure and loops
+        s.set("phase", "on 3 'drum_snare_hard'\n" + seq);
+        REQUIRE(s.run(1) == sounds { "5.1.1 drum_bass_hard", "5.3.1 drum_snare_hard" });
+    }
+    SECTION("Empty sequence")
+    {
+        // rejected by the parser, a tree built otherwise plays nothing instead of crashing
+        parser prs(pool);
+        prs.buffer = "def g:\n  on 1 'beep'\nseq 0\n  use g\n";
+        REQUIRE(!prs.parse());
+
+        ast t;
+        auto const def  = t.add(pattern_def { "g" });
+        auto const beat = t.add(on_beat { 1 });
+        auto const play = t.add(play_sound { pool.intern(synth {}) });
+        auto const seq  = t.add(sequence { 0 });
+        auto const use  = t.add(pattern_use { "g" });
+        t.get<on_beat>(beat).statements    = t.add_links({ play });
+        t.get<pattern_def>(def).statements = t.add_links({ beat });
+        t.get<sequence>(seq).statements    = t.add_links({ use });
+        t.set_roots({ def, seq });
+        s.ch.set_mix("zero", std::make_shared<ast const>(std::move(t)));
+        REQUIRE(s.run(2).empty());
+    }
+}
\ No newline at end of file
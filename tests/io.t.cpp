@@ -0,0 +1,421 @@
+#include "catch2/catch.hpp"
+#include "io/event_log.hpp"
+#include "io/file_watcher.hpp"
+#include "io/midi.hpp"
+#include "io/save_worker.hpp"
+#include "io/score.hpp"
+#include "io/session.hpp"
+#include "parser/parser.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string read(fs::path const& p)
+{
+    std::ifstream t(p, std::ifstream::binary);
+    return std::string(std::istreambuf_iterator<char>(t), std::istreambuf_iterator<char>());
+}
+
+// changes reported within a second
+std::vector<std::string> wait_changes(file_watcher& w)
+{
+    std::vector<std::string> changed;
+    for (int i = 0; i < 1000 && changed.empty(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        changed = w.poll();
+    }
+    return changed;
+}
+
+uint32_t be32(std::string const& s, size_t at)
+{
+    auto const* b = reinterpret_cast<unsigned char const*>(s.data() + at);
+    return uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 | b[3];
+}
+
+// a bundle of a score, its time in seconds and its messages
+struct score_bundle {
+    double                   time = 0;
+    std::vector<std::string> msgs;
+};
+
+// bundles prefixed by their size, none when one does not fit
+std::vector<score_bundle> read_score(std::string const& s)
+{
+    std::vector<score_bundle> bundles;
+    for (size_t at = 0; at < s.size();) {
+        size_t const end = at + 4 + (s.size() - at >= 20 ? be32(s, at) : 0);
+        if (end < at + 20 || end > s.size() || s.compare(at + 4, 8, std::string("#bundle", 8))) {
+            return {};
+        }
+        score_bundle b;
+        b.time = be32(s, at + 12) + be32(s, at + 16) / 4294967296.0;
+        for (at += 20; at + 4 <= end; at += 4 + b.msgs.back().size()) {
+            b.msgs.push_back(s.substr(at + 4, std::min<size_t>(be32(s, at), end - at - 4)));
+        }
+        if (at != end) {
+            return {};
+        }
+        bundles.push_back(std::move(b));
+    }
+    return bundles;
+}
+
+uint32_t read_var(std::string const& s, size_t& at)
+{
+    uint32_t v = 0;
+    while (at < s.size()) {
+        auto const b = uint8_t(s[at++]);
+        v            = v << 7 | (b & 0x7f);
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    return v;
+}
+
+// tick and bytes of each event of a track
+using midi_track = std::vector<std::pair<uint32_t, std::string>>;
+
+// tracks of a standard MIDI file, none when a chunk size does not match its events
+std::vector<midi_track> read_midi(std::string const& s)
+{
+    std::vector<midi_track> tracks;
+    for (size_t at = 14; at < s.size();) {
+        size_t const end = at + 8 + (s.size() - at >= 8 ? be32(s, at + 4) : 0);
+        if (end < at + 8 || end > s.size() || s.compare(at, 4, "MTrk") != 0) {
+            return {};
+        }
+        midi_track t;
+        uint32_t   tick = 0;
+        for (at += 8; at < end;) {
+            tick += read_var(s, at);
+            auto const begin = at;
+            if (uint8_t(s[at]) == 0xff) {
+                at += 2;
+                auto const size = read_var(s, at);
+                at += size;
+            }
+            else {
+                at += 3;
+            }
+            t.emplace_back(tick, s.substr(begin, at - begin));
+        }
+        if (at != end) {
+            return {};
+        }
+        tracks.push_back(std::move(t));
+    }
+    return tracks;
+}
+
+} // namespace
+
+TEST_CASE("IO")
+{
+    auto const dir = fs::temp_directory_path() / "dacapo-io-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string const file = (dir / "mix.dcp").generic_string();
+
+    SECTION("Save")
+    {
+        save_worker         saver(std::chrono::milliseconds(20));
+        save_worker::result res;
+        saver.submit(file, "tempo 1", 1);
+        saver.submit(file, "tempo 2", 2);
+        REQUIRE(!saver.poll(res));
+        for (int i = 0; i < 500 && !saver.poll(res); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(res.ok);
+        REQUIRE(res.version == 2);
+        REQUIRE(read(file) == "tempo 2");
+        REQUIRE(!fs::exists(save_worker::temp_path(file)));
+        REQUIRE(!saver.poll(res));
+
+        saver.submit(file, "tempo 3", 3);
+        saver.flush();
+        REQUIRE(read(file) == "tempo 3");
+        REQUIRE(saver.poll(res));
+        REQUIRE(res.version == 3);
+
+        saver.submit((dir / "missing" / "mix.dcp").generic_string(), "tempo 4", 4);
+        saver.flush();
+        REQUIRE(saver.poll(res));
+        REQUIRE(!res.ok);
+        REQUIRE(!res.error.empty());
+    }
+    SECTION("Save on exit")
+    {
+        {
+            save_worker saver(std::chrono::hours(1));
+            saver.submit(file, "tempo 5", 5);
+        }
+        REQUIRE(read(file) == "tempo 5");
+    }
+    SECTION("Watch")
+    {
+        file_watcher watcher;
+        watcher.watch(dir);
+        REQUIRE(watcher.poll().empty());
+
+        std::ofstream(file) << "tempo 1";
+        REQUIRE(wait_changes(watcher) == std::vector<std::string> { file });
+
+        save_worker saver(std::chrono::milliseconds(0));
+        saver.submit(file, "tempo 2", 2);
+        saver.flush();
+        std::ofstream((dir / "notes.txt").generic_string()) << "x";
+        REQUIRE(wait_changes(watcher) == std::vector<std::string> { file });
+
+        fs::remove(file);
+        REQUIRE(wait_changes(watcher) == std::vector<std::string> { file });
+    }
+    SECTION("Session")
+    {
+        sound_defs const sounds { { "beep" }, { "drum_bass_hard" } };
+        sound_pool       pool(sounds);
+        parser           prs(pool);
+        prs.buffer = "seq 2\n  on 1 'beep' ( note:60 )\n  on 3 'drum_bass_hard'";
+        REQUIRE(prs.parse());
+
+        session s;
+        s.folder  = dir.generic_string();
+        s.running = true;
+        s.tempo   = 120;
+        s.measure = 17;
+        s.beat    = 3;
+        s.synths  = sounds.synths();
+        s.samples = sounds.samples();
+        s.mixes.push_back({ file, 42, prs.tree, { { 0, 15, 1 } } });
+        // the folder is created by the first write
+        auto const path = dir / "cache" / "session";
+        {
+            session_writer writer(path);
+            writer.submit(s);
+            writer.flush();
+            REQUIRE(fs::exists(path));
+            std::string error = "none";
+            REQUIRE(writer.poll(error));
+            REQUIRE(error.empty());
+            REQUIRE(!writer.poll(error));
+            s.measure = 18;
+            writer.submit(s);
+        }
+
+        session r;
+        REQUIRE(r.load(path, pool));
+        REQUIRE(r.folder == s.folder);
+        REQUIRE(r.running);
+        REQUIRE(r.tempo == 120);
+        REQUIRE(r.measure == 18);
+        REQUIRE(r.beat == 3);
+        REQUIRE(r.mixes.size() == 1);
+        auto const& m = r.mixes[0];
+        REQUIRE(m.filename == file);
+        REQUIRE(m.content == 42);
+        REQUIRE(m.sequences.size() == 1);
+        REQUIRE(m.sequences[0].start_m == 15);
+        REQUIRE(m.sequences[0].loops == 1);
+        std::string printed, restored;
+        print(*prs.tree, sounds, printed);
+        print(*m.tree, sounds, restored);
+        REQUIRE(restored == printed);
+
+        // trees refer to sounds by id
+        sound_defs const other { { "beep", "piano" }, { "drum_bass_hard" } };
+        sound_pool       other_pool(other);
+        REQUIRE(!session().load(path, other_pool));
+
+        fs::resize_file(path, fs::file_size(path) - 3);
+        REQUIRE(!session().load(path, pool));
+        REQUIRE(!session().load(dir / "missing", pool));
+
+        // a failed write is reported
+        std::ofstream((dir / "plain").generic_string()) << "x";
+        session_writer broken(dir / "plain" / "session");
+        broken.submit(s);
+        broken.flush();
+        std::string error;
+        REQUIRE(broken.poll(error));
+        REQUIRE(!error.empty());
+    }
+    SECTION("Event log")
+    {
+        sound_defs const sounds { { "beep" }, { "drum_bass_hard" } };
+        auto const       path = dir / "events";
+        {
+            event_log_writer writer(path, sounds);
+            writer.append("lead", { 3, 20 }, "beep");
+            writer.append("drums", { 0, 14 }, std::string("kick\0", 5));
+            writer.flush();
+            REQUIRE(writer.ok());
+            REQUIRE(fs::file_size(path) > 0);
+            writer.append("lead", { 21, 40 }, "boop");
+        }
+
+        event_log log;
+        REQUIRE(log.load(path));
+        REQUIRE(log.synths == sounds.synths());
+        REQUIRE(log.samples == sounds.samples());
+        REQUIRE(log.mixes == std::vector<std::string> { "lead", "drums" });
+        REQUIRE(log.events.size() == 3);
+        auto const& e = log.events;
+        REQUIRE(e[1].mix == 1);
+        REQUIRE(e[1].osc == std::string("kick\0", 5));
+        REQUIRE(e[2].mix == 0);
+        REQUIRE(e[2].src.begin == 21);
+        REQUIRE(e[2].src.end == 40);
+        REQUIRE(e[2].osc == "boop");
+        REQUIRE(e[0].time_us <= e[1].time_us);
+        REQUIRE(e[1].time_us <= e[2].time_us);
+
+        // a record cut by a crash is dropped, the ones before are kept
+        fs::resize_file(path, fs::file_size(path) - 2);
+        event_log cut;
+        REQUIRE(cut.load(path));
+        REQUIRE(cut.events.size() == 2);
+
+        std::ofstream(dir / "other") << "not a log";
+        REQUIRE(!event_log().load(dir / "other"));
+        REQUIRE(!event_log().load(dir / "missing"));
+    }
+    SECTION("Drum map")
+    {
+        sound_defs const sounds { { "beep" },
+                                  { "drum_bass_hard", "drum_snare_soft", "drum_cymbal_open",
+                                    "drum_cymbal_closed", "ambi_choir" } };
+        auto map = default_drum_map(sounds);
+        REQUIRE(map == drum_map { 36, 38, 46, 42, -1 });
+
+        std::string error;
+        std::ofstream(dir / "drums") << "# kit\nambi_choir 60\n\ndrum_bass_hard 35 # low\n";
+        REQUIRE(read_drum_map(dir / "drums", sounds, map, error));
+        REQUIRE(map == drum_map { 35, 38, 46, 42, 60 });
+
+        std::ofstream(dir / "drums") << "beep 60\n";
+        REQUIRE(!read_drum_map(dir / "drums", sounds, map, error));
+        REQUIRE(error == "line 1: unknown sample 'beep'");
+        std::ofstream(dir / "drums") << "ambi_choir\n";
+        REQUIRE(!read_drum_map(dir / "drums", sounds, map, error));
+        REQUIRE(error == "line 1: expected '<sample> <note>'");
+        REQUIRE(!read_drum_map(dir / "missing", sounds, map, error));
+    }
+    SECTION("Score")
+    {
+        sound_defs const sounds { { "beep" }, { "drum_bass_hard" } };
+        sound_pool       pool(sounds);
+        parser           prs(pool);
+        prs.buffer = "tempo 120\non 1 'beep' ( note:60 )\non 3 'drum_bass_hard'\n";
+        REQUIRE(prs.parse());
+
+        std::string const              packet("/d_load\0,s\0\0beep.scsyndef\0\0", 28);
+        std::vector<std::string> const load { packet };
+        score_options                  opt;
+        opt.seconds = 2.3;
+        opt.tail    = 1;
+        opt.tempo   = 60;
+
+        auto const res = write_score(dir / "score.osc", { { "drums", prs.tree } }, pool, load, opt);
+        REQUIRE(res.ok);
+        REQUIRE(res.sounds == 3);
+        // the tail starts after the first sub beat past 2.3s, a sub beat is 1/96s
+        REQUIRE(res.seconds == Approx(221 / 96.0 + 1));
+
+        auto const score   = read(dir / "score.osc");
+        auto const bundles = read_score(score);
+        REQUIRE(bundles.size() == 5);
+        // size, #bundle, time tag, then each message after its size
+        REQUIRE(be32(score, 0) == 16 + 4 + 28);
+        REQUIRE(be32(score, 12) == 0);
+        REQUIRE(be32(score, 16) == 0);
+        REQUIRE(bundles[0].msgs == load);
+
+        // the mix sets the tempo on the first sub beat, a beat then lasts half a second
+        REQUIRE(bundles[1].time == 0);
+        REQUIRE(bundles[2].time == Approx(1).margin(1e-6));
+        REQUIRE(bundles[3].time == Approx(2).margin(1e-6));
+        for (size_t i = 1; i < 4; i++) {
+            REQUIRE(bundles[i].msgs.size() == 1);
+            REQUIRE(bundles[i].msgs[0].compare(0, 8, std::string("/s_new\0\0", 8)) == 0);
+        }
+        REQUIRE(bundles[1].msgs[0] == bundles[3].msgs[0]);
+        REQUIRE(bundles[1].msgs[0] != bundles[2].msgs[0]);
+
+        REQUIRE(bundles[4].time == Approx(res.seconds).margin(1e-6));
+        REQUIRE(bundles[4].msgs.size() == 1);
+        REQUIRE(bundles[4].msgs[0] == std::string("/c_set\0\0,ii\0\0\0\0\0\0\0\0\0", 20));
+        REQUIRE(be32(score, score.size() - 20 - 4) == 20);
+
+        REQUIRE(!write_score(dir / "missing" / "score.osc", {}, pool, load, opt).ok);
+    }
+    SECTION("MIDI")
+    {
+        sound_defs const sounds { { "beep" }, { "drum_bass_hard", "ambi_choir" } };
+        sound_pool       pool(sounds);
+        parser           lead(pool);
+        lead.buffer = "tempo 120\n"
+                      "on 1 'beep' ( note:60 release:1 )\n"
+                      "on 2 'beep' ( note:60 release:0.25 )\n";
+        REQUIRE(lead.parse());
+        parser drums(pool);
+        drums.buffer = "on 1 'ambi_choir'\non 3 'drum_bass_hard'\n";
+        REQUIRE(drums.parse());
+
+        midi_options opt;
+        opt.seconds = 2.3;
+        opt.tempo   = 60;
+
+        mix_trees const trees { { "lead", lead.tree }, { "drums", drums.tree } };
+        auto const      res = write_midi(dir / "song.mid", trees, pool, opt);
+        REQUIRE(res.ok);
+        REQUIRE(res.notes == 4);
+        REQUIRE(res.skipped == 2);
+
+        // format 1, a tempo track and a track per mix, 48 ticks per quarter note
+        auto const midi = read(dir / "song.mid");
+        REQUIRE(midi.compare(0, 14, std::string("MThd\0\0\0\6\0\1\0\3\0\x30", 14)) == 0);
+        auto const tracks = read_midi(midi);
+        REQUIRE(tracks.size() == 3);
+
+        // a beat is 48 ticks at the tempo set by the mix, 2.3s are 221 ticks
+        using e = std::pair<uint32_t, std::string>;
+        auto name = [](std::string n) { return std::string("\xff\x03", 2) + char(n.size()) + n; };
+        std::string const end_of_track("\xff\x2f\x00", 3);
+
+        REQUIRE(tracks[0]
+                == midi_track { e { 0, std::string("\xff\x58\x04\x04\x02\x18\x08", 7) },
+                                e { 0, std::string("\xff\x51\x03\x07\xa1\x20", 6) },
+                                e { 221, end_of_track } });
+        // the delta of the end of track takes two bytes
+        REQUIRE(midi.find(std::string("\x81\x5d\xff\x2f\x00", 5)) != std::string::npos);
+
+        // tracks by mix name, samples on channel 10 for a sixteenth
+        REQUIRE(tracks[1]
+                == midi_track { e { 0, name("drums") },
+                                e { 96, "\x99\x24\x64" },
+                                e { 108, std::string("\x89\x24\x00", 3) },
+                                e { 221, end_of_track } });
+
+        // the note played again at tick 48 cuts the first one, whose later note off is dropped
+        // a note still sounding at the end is ended after the last tick
+        REQUIRE(tracks[2]
+                == midi_track { e { 0, name("lead") },
+                                e { 0, "\x90\x3c\x64" },
+                                e { 48, std::string("\x80\x3c\x00", 3) },
+                                e { 48, "\x90\x3c\x64" },
+                                e { 72, std::string("\x80\x3c\x00", 3) },
+                                e { 192, "\x90\x3c\x64" },
+                                e { 288, std::string("\x80\x3c\x00", 3) },
+                                e { 288, end_of_track } });
+
+        REQUIRE(!write_midi(dir / "missing" / "song.mid", {}, pool, opt).ok);
+    }
+    fs::remove_all(dir);
+}
@@ -0,0 +1,71 @@
+#include "catch2/catch.hpp"
+#include "parser/lexer.hpp"
+#include "parser/lexertk.hpp"
+
+namespace {
+
+char const* const mix_sample = R"( ~ two measures sequence
+seq 2
+  on 1 'drum_bass_hard'
+  on 2 4/4 'drum_cymbal_closed'
+2-: seq 4
+  on 1 'piano' ( note:55 amp:0.2 attack:1.5e-1 )
+tempo 120
+)";
+
+token::token_type lexertk_type(lexertk::token const& t)
+{
+    switch (t.type) {
+    case lexertk::token::e_number: return token::e_number;
+    case lexertk::token::e_symbol: return token::e_symbol;
+    case lexertk::token::e_string: return token::e_string;
+    case lexertk::token::e_comment: return token::e_comment;
+    case lexertk::token::e_eof: return token::e_eof;
+    default: return token::token_type(t.type);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Lexer")
+{
+    SECTION("Same tokens as lexertk")
+    {
+        lexer l;
+        REQUIRE(l.process(mix_sample));
+        lexertk::generator g;
+        REQUIRE(g.process(mix_sample));
+        REQUIRE(l.size() == g.size());
+        for (size_t i = 0; i < l.size(); i++) {
+            REQUIRE(l[i].type == lexertk_type(g[i]));
+            // lexertk comments start after the '~ '
+            size_t const skipped = l[i].type == token::e_comment ? 2 : 0;
+            REQUIRE(l[i].value.substr(skipped) == g[i].value);
+            REQUIRE(l[i].position + skipped == g[i].position);
+            REQUIRE(l[i].end == g[i].end);
+        }
+        REQUIRE(l[l.size()].type == token::e_eof);
+    }
+    SECTION("Tokens")
+    {
+        lexer l;
+        REQUIRE(l.process(""));
+        REQUIRE(l.size() == 0);
+        REQUIRE(l.process("~\n1"));
+        REQUIRE(l[0].type == token::e_comment);
+        REQUIRE(l[0].value == "~");
+        REQUIRE(l[1].type == token::e_number);
+        REQUIRE(l.process(".5 1. 2e3 a_1 +*%^"));
+        REQUIRE(l.size() == 8);
+        REQUIRE(l[2].value == "2e3");
+        REQUIRE(l[3].value == "a_1");
+        REQUIRE(l[7].type == token::e_pow);
+
+        REQUIRE(!l.process("1 'unterminated"));
+        REQUIRE(l[l.size() - 1].type == token::e_error);
+        REQUIRE(!l.process("1.2.3"));
+        REQUIRE(!l.process("1e"));
+        REQUIRE(!l.process("on 1 #"));
+        REQUIRE(l[l.size() - 1].position == 5);
+    }
+}
\ No newline at end of file
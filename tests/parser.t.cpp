@@ -1,24 +1,544 @@
 #include "catch2/catch.hpp"
+#include "parser/ast_io.hpp"
+#include "parser/parse_cache.hpp"
+#include "parser/parse_worker.hpp"
 #include "parser/parser.hpp"
 
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+template<typename T>
+T const& root(ast const& a, size_t i = 0)
+{
+    return a.get<T>(a.roots()[i]);
+}
+
 TEST_CASE("Parser")
 {
     SECTION("Unit")
     {
         auto parse = [](auto data) {
-            parser prs({});
+            static sound_defs const no_sounds;
+            parser                  prs(no_sounds);
             prs.buffer = data;
             prs.parse();
             return prs.tree;
         };
 
-        REQUIRE(parse("").empty());
-        REQUIRE(std::get<comment>(parse("~test").at(0)).text == "test");
-        REQUIRE(std::get<affect>(parse("tempo 1").at(0)).name == "tempo");
-        REQUIRE(std::get<affect>(parse("tempo 1").at(0)).val == 1);
-        REQUIRE(std::get<on_beat>(parse("on 1 rest").at(0)).beat == 1);
-        REQUIRE(std::get<on_beat>(parse("on 1 2/3 rest").at(0)).sub_beat == 2);
-        REQUIRE(std::get<on_beat>(parse("on 1 2/3 rest").at(0)).nb_sub == 3);
-        REQUIRE(std::get<sequence>(parse("seq 3 rest").at(0)).nb_measure == 3);
+        REQUIRE(parse("")->empty());
+        REQUIRE(root<comment>(*parse("~test")).text == "test");
+        REQUIRE(root<comment>(*parse("~ \ttest")).text == "test");
+        REQUIRE(root<affect>(*parse("tempo 1")).name == "tempo");
+        REQUIRE(root<affect>(*parse("tempo 1")).val == 1);
+        REQUIRE(root<on_beat>(*parse("on 1 rest")).beat == 1);
+        REQUIRE(root<on_beat>(*parse("on 1 2/3 rest")).sub_beat == 2);
+        REQUIRE(root<on_beat>(*parse("on 1 2/3 rest")).nb_sub == 3);
+        REQUIRE(root<sequence>(*parse("seq 3 rest")).nb_measure == 3);
+
+        // a comment is highlighted from its '~' to the end of the line
+        sound_defs const sounds;
+        parser           prs(sounds);
+        prs.buffer = " ~  note";
+        REQUIRE(prs.parse());
+        REQUIRE(prs.char_types[0] == char_type::none);
+        REQUIRE(std::vector<char_type>(prs.char_types.begin() + 1, prs.char_types.end())
+                == std::vector<char_type>(7, char_type::comment));
+    }
+    SECTION("Params")
+    {
+        REQUIRE(synth::find_param("note") == synth::note);
+        REQUIRE(synth::find_param("out_bus") == synth::out_bus);
+        REQUIRE(synth::find_param("nope") == -1);
+        REQUIRE(sample::find_param("relax_time_slide") == sample::relax_time_slide);
+        REQUIRE(std::string(sample::param_name(sample::lpf_min)) == "lpf_min");
+
+        sound_defs const sounds { { "beep" }, {} };
+        parser           prs(sounds);
+        prs.buffer = "'beep' ( note:60 amp:0.5 )";
+        REQUIRE(prs.parse());
+        auto const& s = std::get<synth>(root<play_sound>(*prs.tree).sound->sound);
+        REQUIRE(s.params.at(synth::note) == 60);
+        REQUIRE(s.params.at(synth::amp) == 0.5f);
+        REQUIRE(!s.params.contains(synth::pan));
+
+        decltype(sample::params) ps;
+        ps[sample::out_bus] = 2;
+        ps[sample::amp]     = 1;
+        ps[sample::hpf]     = 3;
+        ps[sample::amp]     = 4;
+        std::vector<std::pair<sample::param, float>> const ordered(ps.begin(), ps.end());
+        REQUIRE(ordered.size() == 3);
+        REQUIRE(ordered[0] == std::make_pair(sample::amp, 4.f));
+        REQUIRE(ordered[1] == std::make_pair(sample::hpf, 3.f));
+        REQUIRE(ordered[2] == std::make_pair(sample::out_bus, 2.f));
+        ps.erase(sample::hpf);
+        REQUIRE(ps.size() == 2);
+        REQUIRE(ps.at(sample::out_bus) == 2);
+        auto other           = ps;
+        other[sample::pitch] = 5;
+        REQUIRE(other != ps);
+        other.erase(sample::pitch);
+        REQUIRE(other == ps);
+
+        prs.buffer = "'beep' ( nope:60 )";
+        REQUIRE(!prs.parse());
+    }
+    SECTION("Values")
+    {
+        sound_defs const sounds { { "beep" }, {} };
+        parser           prs(sounds);
+        prs.buffer = "root 48\n"
+                     "tempo root*2 + -6\n"
+                     "'beep' ( note:root+7 amp:0.2*2 pan:-1 )\n"
+                     "'beep' ( note:max(c4, root) release:(1+1)^3 % 5 )";
+        REQUIRE(prs.parse());
+        auto const& a = *prs.tree;
+        REQUIRE(root<affect>(a, 1).val == 90);
+        auto const& s1 = std::get<synth>(root<play_sound>(a, 2).sound->sound);
+        REQUIRE(s1.params.at(synth::note) == 55);
+        REQUIRE(s1.params.at(synth::amp) == Approx(0.4));
+        REQUIRE(s1.params.at(synth::pan) == -1);
+        auto const& s2 = std::get<synth>(root<play_sound>(a, 3).sound->sound);
+        REQUIRE(s2.params.at(synth::note) == 60);
+        REQUIRE(s2.params.at(synth::release) == 3);
+
+        std::string printed;
+        print(a, sounds, printed);
+        REQUIRE(printed.find("tempo root*2 + -6") != std::string::npos);
+        REQUIRE(printed.find("note:max(c4, root)") != std::string::npos);
+        prs.buffer = printed;
+        REQUIRE(prs.parse());
+        REQUIRE(std::get<synth>(root<play_sound>(*prs.tree, 2).sound->sound).params
+                == s1.params);
+
+        prs.buffer = "'beep' ( note:nope+1 )";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "unknown value 'nope'");
+        prs.buffer = "tempo 1/0";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "division by zero");
+        prs.buffer = "'beep' ( note:max(1) )";
+        REQUIRE(!prs.parse());
+        prs.buffer = "'beep' ( note:max(1 -2) )";
+        REQUIRE(!prs.parse());
+        prs.buffer = "'beep' ( note:max(1 2) )";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "expected ',' between the arguments of 'max'");
+        prs.buffer = "'beep' ( note:max(1, -2) )";
+        REQUIRE(prs.parse());
+        REQUIRE(std::get<synth>(root<play_sound>(*prs.tree, 0).sound->sound).params.at(synth::note)
+                == 1);
+        prs.buffer = "'beep' ( note:(0-8)^0.5 )";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "value of param 'note' is not a finite number");
+        prs.buffer = "tempo 10^100";
+        REQUIRE(!prs.parse());
+    }
+    SECTION("Sounds")
+    {
+        sound_defs const sounds { { "beep", "piano" }, { "bass_hard", "drum_bass_soft", "beep" } };
+        REQUIRE(sounds.find("piano")->kind == sound_kind::synth);
+        REQUIRE(sounds.find("beep")->kind == sound_kind::synth);
+        REQUIRE(sounds.find("drum_bass_soft")->id == 1);
+        REQUIRE(!sounds.find("drum"));
+        REQUIRE(sounds.complete("").size() == 4);
+        auto const c = sounds.complete("bas");
+        REQUIRE(c.size() == 2);
+        REQUIRE(c[0] == "bass_hard");
+        REQUIRE(c[1] == "drum_bass_soft");
+        REQUIRE(sounds.complete("dbs").size() == 1);
+        REQUIRE(sounds.complete("x").empty());
+    }
+    SECTION("Loops")
+    {
+        sound_defs const sounds { {}, { "drum_bass_hard", "drum_cymbal_closed" } };
+        parser           prs(sounds);
+        prs.buffer = "seq 2\n"
+                     "  repeat 4\n"
+                     "    on 1 'drum_bass_hard'\n"
+                     "    on 2 'drum_cymbal_closed'\n"
+                     "    every 2 on 2 2/2 'drum_cymbal_closed'\n"
+                     "  every 3\n"
+                     "    on 8 'drum_bass_hard'\n"
+                     "3: repeat 2 on 1 'drum_bass_hard'\n";
+        REQUIRE(prs.parse());
+        auto const& a = *prs.tree;
+        REQUIRE(a.roots().size() == 2);
+        auto const body = a.children(root<sequence>(a).statements);
+        REQUIRE(body.size() == 2);
+        auto const& rep = a.get<repeat>(body[0]);
+        REQUIRE(rep.times == 4);
+        auto const rep_body = a.children(rep.statements);
+        REQUIRE(rep_body.size() == 3);
+        REQUIRE(a.is<on_beat>(rep_body[1]));
+        REQUIRE(a.get<every>(rep_body[2]).period == 2);
+        REQUIRE(a.children(a.get<every>(rep_body[2]).statements).size() == 1);
+        REQUIRE(a.get<every>(body[1]).period == 3);
+        auto const m3 = a.children(root<between_measure>(a, 1).statements);
+        REQUIRE(a.get<repeat>(m3[0]).times == 2);
+
+        std::string printed;
+        print(a, sounds, printed);
+        prs.buffer = printed;
+        REQUIRE(prs.parse());
+        std::string reprinted;
+        print(*prs.tree, sounds, reprinted);
+        REQUIRE(printed == reprinted);
+
+        prs.buffer = "repeat 0 rest";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "expected a positive number after 'repeat'");
+        prs.buffer = "every";
+        REQUIRE(!prs.parse());
+
+        // sequences keep their pairing when nodes are inserted before them
+        prs.buffer = "seq 2\n  on 1 'drum_bass_hard'\n"
+                     "seq 4\n  on 1 'drum_bass_hard'\n"
+                     "seq 3\n  on 2 'drum_bass_hard'\n";
+        REQUIRE(prs.parse());
+        auto const before = prs.tree;
+
+        prs.buffer = "on 1 'drum_cymbal_closed'\n"
+                     "seq 2\n  on 1 'drum_bass_hard'\n"
+                     "seq 8\n  on 1 'drum_bass_hard'\n"
+                     "seq 4\n  on 1 'drum_bass_hard'\n"
+                     "seq 3\n  on 2 'drum_bass_hard'\n  on 4 'drum_cymbal_closed'\n";
+        REQUIRE(prs.parse());
+        auto const after = prs.tree;
+        auto const pairs = match_sequences(*before, *after);
+        REQUIRE(pairs.size() == 3);
+        for (auto const& [from, to] : pairs) {
+            REQUIRE(before->get<sequence>(from).nb_measure == after->get<sequence>(to).nb_measure);
+        }
+        REQUIRE(pairs[0].second == after->roots()[1]);
+        REQUIRE(pairs[1].second == after->roots()[3]);
+        REQUIRE(pairs[2].second == after->roots()[4]);
+    }
+    SECTION("Patterns")
+    {
+        sound_defs const sounds { { "beep" }, { "drum_bass_hard" } };
+        parser           prs(sounds);
+        prs.buffer = "def groove:\n"
+                     "  on 1 'drum_bass_hard'\n"
+                     "  on 3 'beep' ( note:60 )\n"
+                     "use groove\n"
+                     "2: use groove ( transpose:-12 offset:1 )\n";
+        REQUIRE(prs.parse());
+        auto const& a = *prs.tree;
+        REQUIRE(a.roots().size() == 3);
+        auto const& def = root<pattern_def>(a);
+        REQUIRE(def.name == "groove");
+        REQUIRE(a.children(def.statements).size() == 2);
+        REQUIRE(root<pattern_use>(a, 1).transpose == 0);
+        auto const  m2  = a.children(root<between_measure>(a, 2).statements);
+        auto const& use = a.get<pattern_use>(m2[0]);
+        REQUIRE(use.name == "groove");
+        REQUIRE(use.transpose == -12);
+        REQUIRE(use.offset == 1);
+
+        std::string printed;
+        print(a, sounds, printed);
+        prs.buffer = printed;
+        REQUIRE(prs.parse());
+        std::string reprinted;
+        print(*prs.tree, sounds, reprinted);
+        REQUIRE(printed == reprinted);
+
+        prs.buffer = "def a: ~a\ndef a: ~b";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "pattern 'a' already defined");
+        prs.buffer = "use a ( pitch:2 )";
+        REQUIRE(!prs.parse());
+        prs.buffer = "def g:\n  on 1 'beep'\nseq 0\n  use g\n";
+        REQUIRE(!prs.parse());
+        REQUIRE(prs.error == "expected a positive number of measure after 'seq'");
+        prs.buffer = "seq -1\n  use g\n";
+        REQUIRE(!prs.parse());
+    }
+    SECTION("Imports")
+    {
+        sound_defs const sounds { { "beep" }, {} };
+        sound_pool       pool(sounds);
+        parser           scale(pool);
+        scale.filename = "show/scale.dcp";
+        scale.buffer   = "root 48\nfifth root+7\n";
+        REQUIRE(scale.parse());
+
+        parser intro(pool);
+        intro.filename = "show/intro.dcp";
+        intro.mixes    = { { "scale", scale.tree }, { "intro", nullptr } };
+        intro.buffer   = "import 'scale'\n'beep' ( note:fifth+12 )";
+        REQUIRE(intro.parse());
+        auto const good = intro.tree;
+        REQUIRE(root<import_mix>(*good).name == "scale");
+        REQUIRE(std::get<synth>(root<play_sound>(*good, 1).sound->sound).params.at(synth::note)
+                == 67);
+        REQUIRE(imported_mixes(*good) == std::vector<std::string> { "scale" });
+        REQUIRE(intro.imports.size() == 1);
+        REQUIRE(intro.imports[0].hash == import_hash("scale", intro.mixes));
+        std::string printed;
+        print(*good, sounds, printed);
+        REQUIRE(printed.find("import 'scale'") == 0);
+
+        // only the top level values of a mix and its imports change its hash
+        auto const hash = intro.imports[0].hash;
+        scale.buffer    = "root 48\nfifth root+7\non 1 'beep'";
+        REQUIRE(scale.parse());
+        REQUIRE(import_hash("scale", { { "scale", scale.tree } }) == hash);
+        scale.buffer = "root 50\nfifth root+7";
+        REQUIRE(scale.parse());
+        REQUIRE(import_hash("scale", { { "scale", scale.tree } }) != hash);
+        REQUIRE(import_hash("nope", { { "scale", scale.tree } }) == 0);
+
+        // cached trees depend on the values they imported
+        namespace fs      = std::filesystem;
+        auto const folder = fs::temp_directory_path() / "dacapo-import-test";
+        fs::remove_all(folder);
+        parse_cache cache(pool, folder);
+        cache.store(intro);
+        parser cached(pool);
+        cached.mixes  = intro.mixes;
+        cached.buffer = intro.buffer;
+        REQUIRE(cache.load(cached));
+        REQUIRE(cached.imports.size() == 1);
+        REQUIRE(cached.imports[0].hash == hash);
+        cached.mixes["scale"] = scale.tree;
+        REQUIRE(!cache.load(cached));
+        REQUIRE(!fs::is_empty(folder));
+        fs::remove_all(folder);
+
+        intro.buffer = "import 'nope'";
+        REQUIRE(!intro.parse());
+        REQUIRE(intro.error == "unknown mix 'nope'");
+        intro.buffer = "import 'intro'";
+        REQUIRE(!intro.parse());
+        REQUIRE(intro.error == "a mix cannot import itself");
+        intro.mixes["scale"] = nullptr;
+        intro.buffer         = "import 'scale'";
+        REQUIRE(!intro.parse());
+        REQUIRE(intro.error == "mix 'scale' has errors");
+        REQUIRE(intro.imports.size() == 1);
+        REQUIRE(intro.imports[0].hash == 0);
+
+        scale.mixes  = { { "intro", good }, { "scale", nullptr } };
+        scale.buffer = "import 'intro'\nroot 48";
+        REQUIRE(!scale.parse());
+        REQUIRE(scale.error == "import cycle scale -> intro -> scale");
+        REQUIRE(import_cycle("a", [](std::string const& n) {
+                    return n == "a"   ? std::vector<std::string> { "b", "c" }
+                           : n == "c" ? std::vector<std::string> { "a" }
+                                      : std::vector<std::string>();
+                })
+                == "a -> c -> a");
+    }
+    SECTION("Pool")
+    {
+        sound_defs const sounds { { "beep" }, { "drum_cymbal_closed" } };
+        sound_pool       pool(sounds);
+        parser           p1(pool);
+        parser           p2(pool);
+        p1.buffer = "on 1 'drum_cymbal_closed' 'beep' ( note:33 amp:0.2 )\n"
+                    "on 2 'drum_cymbal_closed' 'beep' ( note:33 amp:0.2 )";
+        p2.buffer = "on 3 'beep' ( amp:0.2 note:33 ) 'beep' ( note:34 )";
+        REQUIRE(p1.parse());
+        REQUIRE(p2.parse());
+
+        auto sound = [](ast const& a, size_t beat, size_t i) {
+            auto const& ob = a.get<on_beat>(a.roots()[beat]);
+            return a.get<play_sound>(a.children(ob.statements)[i]).sound;
+        };
+        REQUIRE(sound(*p1.tree, 0, 0) == sound(*p1.tree, 1, 0));
+        REQUIRE(sound(*p1.tree, 0, 1) == sound(*p1.tree, 1, 1));
+        REQUIRE(sound(*p1.tree, 0, 1) == sound(*p2.tree, 0, 0));
+        REQUIRE(sound(*p2.tree, 0, 0) != sound(*p2.tree, 0, 1));
+        REQUIRE(sound(*p1.tree, 0, 0)->osc != sound(*p1.tree, 0, 1)->osc);
+        REQUIRE(pool.size() == 3);
+
+        p2.buffer = "tempo 1";
+        REQUIRE(p2.parse());
+        REQUIRE(pool.size() == 2);
+    }
+    SECTION("Cache")
+    {
+        namespace fs = std::filesystem;
+        auto const folder = fs::temp_directory_path() / "dacapo-cache-test";
+        fs::remove_all(folder);
+
+        sound_defs const sounds { { "beep" }, { "drum_cymbal_closed" } };
+        sound_pool       pool(sounds);
+        parse_cache      cache(pool, folder);
+
+        std::string const mix = "~ intro\n"
+                                "1-4: seq 2\n"
+                                "  on 1 2/3 'drum_cymbal_closed' ( rate:2 )\n"
+                                "  on 2 'beep' ( note:60 amp:0.5 )\n"
+                                "8: tempo 100\n";
+        parser p1(pool);
+        p1.buffer = mix;
+        REQUIRE(!cache.load(p1));
+        REQUIRE(p1.parse());
+        cache.store(p1);
+
+        // the stored result is kept in memory and shared
+        parser p2(pool);
+        p2.buffer = mix;
+        REQUIRE(cache.load(p2));
+        REQUIRE(p2.tree == p1.tree);
+        REQUIRE(p2.char_types == p1.char_types);
+
+        // another cache, as in a new session, decodes the file
+        parse_cache disk(pool, folder);
+        p2.tree.reset();
+        REQUIRE(disk.load(p2));
+        REQUIRE(p2.tree != p1.tree);
+        REQUIRE(p2.char_types == p1.char_types);
+        std::string printed1, printed2;
+        print(*p1.tree, sounds, printed1);
+        print(*p2.tree, sounds, printed2);
+        REQUIRE(printed1 == printed2);
+        auto const& a1 = *p1.tree;
+        auto const& a2 = *p2.tree;
+        REQUIRE(a2.size() == a1.size());
+        REQUIRE(a2.src(a2.roots()[1]).begin == a1.src(a1.roots()[1]).begin);
+
+        p2.buffer += " ";
+        REQUIRE(!cache.load(p2));
+
+        sound_defs const other { { "beep", "piano" }, { "drum_cymbal_closed" } };
+        sound_pool       other_pool(other);
+        parse_cache      other_cache(other_pool, folder);
+        parser           p3(other_pool);
+        p3.buffer = mix;
+        REQUIRE(!other_cache.load(p3));
+
+        // a truncated entry is a miss and gets removed
+        for (auto const& e : fs::directory_iterator(folder)) {
+            fs::resize_file(e.path(), fs::file_size(e.path()) - 3);
+        }
+        p2.buffer = mix;
+        REQUIRE(!parse_cache(pool, folder).load(p2));
+        REQUIRE(fs::is_empty(folder));
+
+        // the second hash of the source follows the first one, another one is a miss
+        cache.store(p1);
+        for (auto const& e : fs::directory_iterator(folder)) {
+            std::fstream f(e.path(), std::ios::binary | std::ios::in | std::ios::out);
+            f.seekp(16);
+            f.put('#');
+        }
+        REQUIRE(!parse_cache(pool, folder).load(p2));
+
+        // a sequence of no measure is corrupt, the player would divide by its length
+        parser p5(pool);
+        p5.buffer = "seq 123456\n  on 1 'beep'\n";
+        REQUIRE(p5.parse());
+        byte_writer w;
+        write_ast(w, *p5.tree);
+        int32_t const nb_measure = 123456;
+        auto const    at         = w.out.find(std::string((char const*)&nb_measure, 4));
+        REQUIRE(at != std::string::npos);
+        byte_reader r5 { w.out.data(), w.out.data() + w.out.size() };
+        ast         a5;
+        REQUIRE(read_ast(r5, a5, pool));
+        std::memset(&w.out[at], 0, 4);
+        byte_reader r6 { w.out.data(), w.out.data() + w.out.size() };
+        ast         a6;
+        REQUIRE(!read_ast(r6, a6, pool));
+
+        // the least recently used entries go when the folder is full
+        fs::remove_all(folder);
+        parser p4(pool);
+        p4.buffer = "tempo 90";
+        REQUIRE(p4.parse());
+        cache.store(p4);
+        auto const size4 = fs::file_size(fs::directory_iterator(folder)->path());
+        fs::remove_all(folder);
+        cache.store(p1);
+        auto const size1 = fs::file_size(fs::directory_iterator(folder)->path());
+        fs::remove_all(folder);
+        parse_cache small(pool, folder, size1 + size4 - 1);
+        small.store(p1);
+        for (auto const& e : fs::directory_iterator(folder)) {
+            fs::last_write_time(e.path(), fs::last_write_time(e.path()) - std::chrono::hours(1));
+        }
+        small.store(p4);
+        parse_cache reopened(pool, folder);
+        REQUIRE(reopened.load(p4));
+        REQUIRE(!reopened.load(p2));
+        fs::remove_all(folder);
+    }
+    SECTION("Worker")
+    {
+        sound_defs const   sounds;
+        parse_worker       worker(sounds, 2);
+        parse_worker::slot slot(worker);
+        slot.submit("tempo 1", 1);
+        slot.submit("tempo", 2);
+        slot.submit("tempo 3", 3);
+
+        // other slots share the threads, a dropped one is skipped
+        std::vector<std::unique_ptr<parse_worker::slot>> others;
+        for (int i = 0; i < 4; i++) {
+            others.push_back(std::make_unique<parse_worker::slot>(worker));
+            others.back()->submit("tempo " + std::to_string(10 + i), 1);
+        }
+        others[1].reset();
+
+        parse_worker::result res;
+        for (int i = 0; i < 500 && res.version != 3; i++) {
+            if (!slot.poll(res)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        REQUIRE(res.version == 3);
+        REQUIRE(res.ok);
+        REQUIRE(root<affect>(*res.tree).val == 3);
+        REQUIRE(res.char_types.size() == 7);
+        REQUIRE(!slot.poll(res));
+
+        for (int i : { 0, 2, 3 }) {
+            parse_worker::result other;
+            for (int j = 0; j < 500 && !others[size_t(i)]->poll(other); j++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            REQUIRE(other.version == 1);
+            REQUIRE(root<affect>(*other.tree).val == 10 + i);
+        }
+    }
+    SECTION("Tree")
+    {
+        sound_defs const sounds { { "piano" }, { "drum_bass_hard", "drum_cymbal_closed" } };
+        parser           prs(sounds);
+        prs.buffer = "2-: seq 2\n"
+                     "  on 1 'drum_bass_hard'\n"
+                     "  on 2 4/4\n"
+                     "    'drum_cymbal_closed'\n"
+                     "    'piano' ( note:55 )\n"
+                     "8: tempo 100\n";
+        REQUIRE(prs.parse());
+        auto const& a = *prs.tree;
+        REQUIRE(a.roots().size() == 2);
+        auto const& bm = root<between_measure>(a);
+        REQUIRE(bm.m2 == -1);
+        auto const seq = a.children(bm.statements);
+        REQUIRE(seq.size() == 1);
+        auto const beats = a.children(a.get<sequence>(seq[0]).statements);
+        REQUIRE(beats.size() == 2);
+        REQUIRE(a.children(a.get<on_beat>(beats[1]).statements).size() == 2);
+        REQUIRE(a.src(beats[1]).begin == 36);
+        REQUIRE(root<between_measure>(a, 1).m1 == 8);
+
+        std::string printed;
+        print(a, sounds, printed);
+        REQUIRE(printed.find("'piano' ( note:55 )") != std::string::npos);
+        prs.buffer = printed;
+        REQUIRE(prs.parse());
+        std::string reprinted;
+        print(*prs.tree, sounds, reprinted);
+        REQUIRE(printed == reprinted);
     }
 }
\ No newline at end of file